@@ -0,0 +1,63 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*
+Stores each distinct string once, packed into large chunks. Handles and the
+views they resolve to stay valid until Retain() rebuilds the pool.
+Handle 0 is always the empty string.
+*/
+class StringInterner {
+ public:
+  using Handle = uint32_t;
+  static constexpr Handle kEmpty = 0;
+
+  StringInterner();
+
+  Handle Intern(std::string_view value);
+  std::string_view View(Handle handle) const { return views_[handle]; }
+  size_t Size() const { return views_.size(); }
+
+  // Drops every string not referenced from `columns` and rewrites the
+  // handles in them. Long-running monitors see an unbounded stream of
+  // distinct command lines, so owners call this once the pool has grown
+  // well past the number of live handles.
+  void Retain(const std::vector<std::vector<Handle>*>& columns);
+
+ private:
+  std::string_view Store(std::string_view value);
+
+  std::vector<std::unique_ptr<char[]>> chunks_;
+  size_t chunk_used_{0};
+  size_t chunk_size_{0};
+  std::vector<std::string_view> views_;
+  std::unordered_map<std::string_view, Handle> index_;
+};
+
+/*
+Bump allocator for strings that only live for one frame. Everything it
+hands out is invalidated by Reset(), which the display calls after each
+render; after the first few frames it stops allocating entirely.
+*/
+class FrameArena {
+ public:
+  // printf-style formatting into the arena
+  std::string_view Format(const char* format, ...)
+      __attribute__((format(printf, 2, 3)));
+  void Reset();
+
+ private:
+  char* Allocate(size_t size);
+
+  std::vector<std::unique_ptr<char[]>> chunks_;
+  size_t chunk_size_{0};
+  size_t used_{0};
+};
+
+#endif
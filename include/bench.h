@@ -0,0 +1,11 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+namespace Bench {
+// Reads `files` /proc/<pid>/stat files (cycling through the live pids) with
+// every available ProcReader backend and prints wall, user and kernel time
+// per pass. Returns the process exit status.
+int Run(int files);
+};  // namespace Bench
+
+#endif
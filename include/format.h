@@ -2,9 +2,13 @@
 #define FORMAT_H
 
 #include <string>
+#include <string_view>
+
+#include "arena.h"
 
 namespace Format {
 std::string ElapsedTime(long times);  // TODO(mgg): DONE
+std::string_view ElapsedTime(long times, FrameArena& arena);
 };                                    // namespace Format
 
 #endif
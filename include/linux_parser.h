@@ -1,9 +1,13 @@
 #ifndef SYSTEM_PARSER_H
 #define SYSTEM_PARSER_H
 
+#include <array>
+#include <cstdint>
 #include <fstream>
+#include <optional>
 #include <regex>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace LinuxParser {
@@ -13,6 +17,7 @@ const std::string kCmdlineFilename{"/cmdline"};
 const std::string kCpuinfoFilename{"/cpuinfo"};
 const std::string kStatusFilename{"/status"};
 const std::string kStatFilename{"/stat"};
+const std::string kIoFilename{"/io"};
 const std::string kUptimeFilename{"/uptime"};
 const std::string kMeminfoFilename{"/meminfo"};
 const std::string kVersionFilename{"/version"};
@@ -50,10 +55,119 @@ long ActiveJiffies(int pid);
 long IdleJiffies();
 
 // Processes
+// Field numbers of /proc/<pid>/stat as listed in proc(5), starting at 1
+enum StatField : int {
+  kStatState = 3,
+  kStatPpid = 4,
+  kStatUtime = 14,
+  kStatStime = 15,
+  kStatCutime = 16,
+  kStatCstime = 17,
+  kStatNumThreads = 20,
+  kStatStarttime = 22,
+  kStatVsize = 23,
+  kStatRss = 24,
+};
+
+// Decodes the listed fields of a stat line in a single pass. The field
+// list is a compile-time constant, so the scan is specialized for it: it
+// starts after comm's closing paren (comm may contain spaces and parens),
+// skips unwanted fields without converting them and stops after the last
+// wanted one. Fields must be in ascending order and values come back in
+// the same order; kStatState yields the state character.
+template <StatField... Fields>
+std::optional<std::array<long long, sizeof...(Fields)>> ParseStat(
+    std::string_view line) {
+  constexpr StatField kFields[] = {Fields...};
+  constexpr int kLast = kFields[sizeof...(Fields) - 1];
+  constexpr uint64_t kWanted = ((uint64_t{1} << Fields) | ...);
+  static_assert(kFields[0] >= kStatState && kLast < 64,
+                "fields after comm only");
+  static_assert(
+      [] {
+        for (size_t i = 1; i < sizeof...(Fields); i++) {
+          if (kFields[i] <= kFields[i - 1]) return false;
+        }
+        return true;
+      }(),
+      "fields must be listed in ascending order");
+
+  size_t comm_end = line.rfind(')');
+  if (comm_end == std::string_view::npos) {
+    return std::nullopt;
+  }
+  std::array<long long, sizeof...(Fields)> values{};
+  const char* p = line.data() + comm_end + 1;
+  const char* end = line.data() + line.size();
+  size_t out = 0;
+  for (int field = kStatState; field <= kLast; field++) {
+    while (p < end && *p == ' ') ++p;
+    if (p == end) {
+      return std::nullopt;
+    }
+    if (kWanted & (uint64_t{1} << field)) {
+      if (field == kStatState) {
+        values[out++] = *p++;
+      } else {
+        bool negative = *p == '-';
+        p += negative;
+        unsigned long long value = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+          value = value * 10 + (*p - '0');
+        }
+        values[out++] = negative ? -static_cast<long long>(value) : value;
+      }
+    }
+    while (p < end && *p != ' ') ++p;
+  }
+  return values;
+}
+
+// Fields of /proc/<pid>/stat the monitor cares about. A single read of the
+// stat file fills all of them so callers never re-tokenize the same line.
+struct ProcStat {
+  bool valid{false};
+  char state{0};
+  int ppid{0};
+  long num_threads{0};
+  long utime{0};
+  long stime{0};
+  long cutime{0};
+  long cstime{0};
+  long starttime{0};  // clock ticks after boot
+  unsigned long vsize{0};  // bytes
+  long rss{0};  // pages
+};
+
+ProcStat Stat(int pid);
+ProcStat ParseStatLine(std::string_view line);
+
+// /proc/<pid>/schedstat: nanosecond run time and run-queue wait
+struct SchedStat {
+  bool valid{false};
+  unsigned long long run_ns{0};
+  unsigned long long wait_ns{0};
+  unsigned long long timeslices{0};
+};
+
+SchedStat ParseSchedstatLine(std::string_view line);
+
+// /proc/<pid>/io: bytes the process caused to be fetched from and sent to
+// storage
+struct IoStat {
+  bool valid{false};
+  unsigned long long read_bytes{0};
+  unsigned long long write_bytes{0};
+};
+
+IoStat ParseIo(std::string_view text);
+long ClockTicks();
 std::string Command(int pid);
-std::string Ram(int pid);
+long Ram(int pid);  // MB
 std::string Uid(int pid);
+std::string EffectiveUid(int pid);
 std::string User(int pid);
+std::string UserName(const std::string& uid);
 long int UpTime(int pid);
 };  // namespace LinuxParser
 
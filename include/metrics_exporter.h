@@ -0,0 +1,55 @@
+#ifndef METRICS_EXPORTER_H
+#define METRICS_EXPORTER_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "system.h"
+
+/*
+Serves the latest snapshot in the Prometheus text exposition format over
+HTTP, on a localhost TCP port and/or a Unix domain socket.
+
+The full HTTP response is rendered once per sampling tick by Publish();
+the server thread only hands out that shared buffer, so any number of
+scrapers never cause extra /proc reads or rendering work.
+*/
+class MetricsExporter {
+ public:
+  // Throws std::runtime_error if a listener can't be set up.
+  MetricsExporter(int port, const std::string& unix_path);
+  ~MetricsExporter();
+  MetricsExporter(const MetricsExporter&) = delete;
+  MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+  // Renders `system` (as of its last Refresh()) and swaps it in as the
+  // response served from now on.
+  void Publish(System& system);
+
+ private:
+  struct Client;
+
+  void Serve();
+  std::shared_ptr<const std::string> Response();
+
+  std::vector<int> listen_fds_;
+  std::string unix_path_;
+  int wake_fd_{-1};
+  std::atomic<bool> stop_{false};
+  std::thread thread_;
+
+  std::mutex mutex_;
+  std::shared_ptr<const std::string> response_;
+  std::string body_;  // reused render buffer
+};
+
+namespace Metrics {
+// Appends the Prometheus text format for `system` to `out`.
+void Render(System& system, std::string& out);
+};  // namespace Metrics
+
+#endif
@@ -4,12 +4,21 @@
 #include <curses.h>
 
 #include "process.h"
+#include "process_table.h"
 #include "system.h"
 
 namespace NCursesDisplay {
-void Display(System& system, int n = 10);
+// Runs until 'q'. The process list fills the rest of the terminal and
+// scrolls with the arrow keys, PgUp/PgDn, Home and End; '/' searches,
+// 'n' finds the next match, c/m/p/t/l/P sort and 'r' reverses the order.
+// 'u' switches between processes and per-user totals.
+void Display(System& system, int interval_ms = 1000);
 void DisplaySystem(System& system, WINDOW* window);
-void DisplayProcesses(std::vector<Process>& processes, WINDOW* window, int n);
+// Draws ranks [first, first + rows that fit) and marks `highlight`'s row.
+void DisplayProcesses(ProcessTable& processes, WINDOW* window, size_t first,
+                      int highlight = -1);
+// Draws the per-user totals from rank `first` on.
+void DisplayUsers(ProcessTable& processes, WINDOW* window, size_t first);
 std::string ProgressBar(float percent);
 };  // namespace NCursesDisplay
 
@@ -0,0 +1,37 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <string>
+#include <vector>
+
+#include "refresh_scheduler.h"
+
+// Command-line configuration of the monitor.
+struct Options {
+  int interval_ms{1000};  // sampling tick
+  int prime_ms{150};      // wait after the baseline sample, 0 for none
+  bool schedstat{false};  // nanosecond CPU time and run-queue latency
+  bool io{false};  // per-process I/O rates from /proc/<pid>/io
+  bool percentiles{false};  // per-process CPU and RSS sketches
+  std::vector<int> pids;  // only track these processes; empty for all
+  RefreshPolicy refresh;
+  bool io_uring{false};  // batch /proc reads through io_uring
+  int max_fds{-1};       // /proc files held open, -1 = from RLIMIT_NOFILE
+
+  int bench_files{0};  // run the reader benchmark over this many files
+
+  // Daemon mode: no ncurses, serve metrics and/or publish snapshots instead.
+  bool daemon{false};
+  int listen_port{0};       // localhost TCP port, 0 for none
+  std::string listen_unix;  // Unix domain socket path, empty for none
+  std::string publish;      // shared-memory segment to publish, e.g. /monitor
+  int shm_max_processes{32768};
+
+  // Viewer mode: render snapshots from this segment instead of /proc.
+  std::string attach;
+};
+
+// Exits with a usage message on invalid arguments.
+Options ParseOptions(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef PROC_READER_H
+#define PROC_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/*
+Reads many small /proc files in one call, into buffers owned by the caller.
+
+The pread backend issues open/pread/close per file. The io_uring backend
+submits the opens, reads and closes for a whole batch as three ring
+submissions, so the syscall count no longer grows with the number of
+files. It talks to the kernel through raw syscalls and needs no library;
+Create() falls back to pread if the ring can't be set up or the kernel
+lacks the opcodes, and Failed() reports a ring that broke later.
+*/
+class ProcReader {
+ public:
+  enum class Backend { kPread, kIoUring };
+
+  struct Request {
+    const char* path;  // used when fd < 0
+    int fd;            // already-open file, or -1 to open `path`
+    bool keep_open;    // leave the file open and return it in `fd`
+    char* buffer;
+    uint32_t capacity;
+    int result;  // bytes read, or -errno
+  };
+
+  static std::unique_ptr<ProcReader> Create(Backend backend);
+  virtual ~ProcReader() = default;
+
+  // Reads each request from offset 0. Files opened here are closed again
+  // unless keep_open is set. The pread backend keeps no state, so disjoint
+  // ranges may be read from several threads at once.
+  virtual void Read(Request* requests, size_t count) = 0;
+  virtual Backend Kind() const = 0;
+  // True once the backend has given up on a kernel error. Reads still
+  // complete, with plain syscalls, but callers should switch to a
+  // Create(Backend::kPread) reader.
+  virtual bool Failed() const { return false; }
+};
+
+#endif
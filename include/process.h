@@ -1,46 +1,41 @@
 #ifndef SYSTEM_MONITOR_PROCESS_H
 #define SYSTEM_MONITOR_PROCESS_H
 
-#include <string>
+#include <cstdint>
+#include <string_view>
 #include <sys/time.h>
 
-#include "linux_parser.h"
+class ProcessTable;
+
 /*
 Basic class for Process representation
 It contains relevant attributes as shown below
+
+A Process is a lightweight view of one row in a ProcessTable; the data
+lives in the table's columns. Command and user are read from /proc the
+first time they are asked for and interned for the life of the process.
+Views, and the strings they return, are only valid until the table's next
+Update().
 */
 class Process {
  public:
   Process() = default;
-  Process(int pid);
-  Process(const Process& other);
-  Process(Process&& other);
-  ~Process() = default;
-
-  Process& operator=(const Process& other);
-  Process& operator=(Process&& other);
+  Process(ProcessTable* table, uint32_t row) : table_(table), row_(row) {}
 
   int Pid() const;
-  std::string User();
-  std::string Command();
+  std::string_view User();
+  std::string_view Command();
   float CpuUtilization();
-  std::string Ram();
+  bool Stale();     // CpuUtilization() is carried over from an earlier tick
+  // ns of run-queue wait per timeslice (schedstat only), negative if unknown
+  float Latency();
+  long Ram();  // MB
   long int UpTime();
   struct timespec StartTime();
-  bool operator<(Process& a);
 
-  // TODO: Declare any necessary private members
  private:
-    // These fields don't change so it makes sense to cache them during initialization
-    int pid_;
-    std::string user_;
-    std::string command_;
-    
-    // CPU utilization tracking
-    long prev_jiffies_{0};
-    struct timespec prev_time_{};
-    struct timespec start_time_{};
-    float cpu_utilization_{0.0};  // Cached CPU utilization value (for sorting with stable values)
+  ProcessTable* table_{nullptr};
+  uint32_t row_{0};
 };
 
 #endif
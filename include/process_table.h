@@ -0,0 +1,257 @@
+#ifndef PROCESS_TABLE_H
+#define PROCESS_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "arena.h"
+#include "linux_parser.h"
+#include "process.h"
+#include "proc_reader.h"
+#include "refresh_scheduler.h"
+#include "sketch.h"
+
+/*
+Columnar store for every process the monitor tracks.
+
+Numeric state lives in parallel, contiguous arrays indexed by row so the
+per-tick delta math and the ranking only stream through the columns they
+need. Command lines and user names are interned in a StringInterner and
+the cold columns only hold handles, filled lazily for rows that are
+actually displayed. Rows are not stable across ticks (exited processes
+are swap-removed); the ranking is a permutation of row indices.
+
+Each row keeps its stat (and schedstat) file open between ticks, so a
+refresh is a single pread instead of a path lookup, open, read and close.
+The descriptors are closed when the row is removed or a read reports
+ESRCH. The number held open is capped below RLIMIT_NOFILE; past the cap,
+the least recently read rows give theirs up.
+
+Per-user totals are maintained incrementally: a row's values are taken
+out of its user's totals before it is re-read and added back after, and
+removed with the row. Rows that are not read on a tick don't change them,
+so the rollup costs nothing beyond the rows already being sampled.
+*/
+class ProcessTable {
+ public:
+  using Row = uint32_t;
+
+  ProcessTable() = default;
+  ProcessTable(const ProcessTable&) = delete;
+  ProcessTable& operator=(const ProcessTable&) = delete;
+  ~ProcessTable();
+
+  // One tick: drops exited pids, adds new ones, reads the rows the
+  // RefreshScheduler plans for this tick (one stat read each, new rows
+  // included), then recomputes utilization and the ranking.
+  void Update(const std::vector<int>& pids);
+  // Update() for the first tick, with the baseline reads of every process
+  // spread over `threads` threads. A row's next read, whenever Update()
+  // next runs, then yields its real utilization.
+  void Prime(const std::vector<int>& pids, int threads);
+
+  void SetRefreshPolicy(const RefreshPolicy& policy) {
+    scheduler_.SetPolicy(policy);
+  }
+  // Ranks [first, first + count) are on screen; they are read every tick.
+  void SetVisible(size_t first, size_t count) {
+    visible_first_ = first;
+    visible_count_ = count;
+  }
+
+  // A process collected elsewhere, e.g. read from a published snapshot
+  struct Sample {
+    int pid;
+    float cpu_utilization;
+    unsigned long vsize;
+    long rss;
+    long start_ticks;
+    float io_rate;
+    uint32_t uid;
+    std::string_view user;
+    std::string_view command;
+  };
+  // Replaces the table with `samples`, already in ranked order. Every field
+  // is marked as loaded, so the table never reads /proc for these rows.
+  void Load(const std::vector<Sample>& samples);
+
+  // CPU time comes from /proc/<pid>/schedstat (nanoseconds, plus run-queue
+  // latency) instead of stat's clock ticks. Costs a second read per row.
+  void SetSchedstat(bool enabled) { schedstat_ = enabled; }
+  bool Schedstat() const { return schedstat_; }
+  // Storage I/O rates from /proc/<pid>/io. Costs another read per row,
+  // and other users' processes are only readable as root.
+  void SetIo(bool enabled) { io_ = enabled; }
+  bool Io() const { return io_; }
+  // Keeps CPU and RSS sketches over 1, 5 and 15 minutes per process, about
+  // 1.3 KB each. Set before the first Update().
+  void SetPercentiles(bool enabled) { percentiles_ = enabled; }
+  bool Percentiles() const { return percentiles_; }
+  // Falls back to pread if io_uring is unavailable; see ProcReader.
+  void SetIoBackend(ProcReader::Backend backend) {
+    reader_ = ProcReader::Create(backend);
+  }
+  // Most /proc files held open between ticks; 0 reopens them every read.
+  // Defaults to the RLIMIT_NOFILE soft limit less a reserve.
+  void SetFdLimit(size_t limit);
+  size_t OpenFds() const { return open_fds_; }
+
+  // Ranking order. Only hot columns are sortable, so re-sorting never
+  // reads /proc.
+  enum class SortKey { kCpu, kMemory, kPid, kTime, kLatency, kCpuP99 };
+  // Re-ranks immediately. `reverse` flips the default order (busiest,
+  // largest, lowest pid, longest running or slowest first).
+  void SetSort(SortKey key, bool reverse);
+  SortKey Sort() const { return sort_key_; }
+  bool SortReversed() const { return sort_reverse_; }
+
+  // Totals over the live processes of one user
+  struct UserUsage {
+    uint32_t uid{0};
+    std::string name;
+    int processes{0};
+    int64_t cpu_ppm{0};  // utilization, in millionths of a CPU
+    long rss{0};         // pages
+    int64_t io_rate{0};  // bytes/s, with SetIo()
+  };
+  // Every user with processes, ordered by CPU, or by RSS or uid when
+  // sorting by memory or pid.
+  const std::vector<UserUsage>& Users();
+
+  size_t Size() const { return pid_.size(); }
+  // View of the process at `rank` in the current order (0 is the top)
+  Process At(size_t rank);
+  Row Ranked(size_t rank) const { return order_[rank]; }
+  // First rank at or after `from` (wrapping around) whose pid equals
+  // `text` or whose command contains it; Size() if none. Loads the command
+  // of every row it passes over.
+  size_t Find(std::string_view text, size_t from);
+
+  int Pid(Row row) const { return pid_[row]; }
+  float CpuUtilization(Row row) const { return utilization_[row]; }
+  // Not read this tick; utilization is carried over from the last sample
+  bool Stale(Row row) const { return sampled_[row] != tick_; }
+  // Mean run-queue wait per timeslice over the last tick; schedstat only.
+  // Negative if the row's schedstat can't be read.
+  float LatencyNs(Row row) const {
+    return valid_[row] & kStatCpu ? -1.0f : latency_ns_[row];
+  }
+  unsigned long Vsize(Row row) const { return vsize_[row]; }
+  long Rss(Row row) const { return rss_[row]; }
+  long StartTicks(Row row) const { return start_ticks_[row]; }
+  float IoRate(Row row) const { return io_rate_[row]; }  // bytes/s
+  // Distribution of the row's samples over `window`; SetPercentiles only
+  Sketch CpuWindow(Row row, Window window) {
+    return cpu_windows_[row].Query(window, minute_);
+  }
+  Sketch RssWindow(Row row, Window window) {  // pages
+    return rss_windows_[row].Query(window, minute_);
+  }
+  uint32_t Uid(Row row) const { return uid_[row]; }
+  std::string_view Command(Row row);
+  std::string_view User(Row row);
+
+ private:
+  // Bits in valid_ for the cold columns that are read lazily.
+  enum Field : uint8_t {
+    kCommand = 1u << 0,
+    kUid = 1u << 1,
+    kUser = 1u << 2,
+    kAccounted = 1u << 3,  // counted in users_
+    kMeasured = 1u << 4,   // read at least twice, so utilization is real
+    kStatCpu = 1u << 5,    // schedstat unreadable; CPU time from stat ticks
+  };
+  // Files read per row; fds_ holds a descriptor column for each
+  enum File : uint8_t { kStatFile, kSchedstatFile, kIoFile, kFileCount };
+
+  void AddRow(int pid);
+  void RemoveRow(Row row);
+  void CloseFds(Row row);
+  void ReadRequests();
+  bool ReadUid(Row row);
+  void Account(Row row);
+  void Unaccount(Row row);
+  void AddUsage(Row row, int sign);
+  void EvictFds(size_t needed);
+  void ReadRows(const Row* rows, size_t count);
+  void Store(Row row, const LinuxParser::ProcStat& stat);
+  void ComputeUtilization();
+  void Rank();
+  static size_t DefaultFdLimit();
+
+  // Hot columns
+  std::vector<int> pid_;
+  std::vector<int64_t> cpu_ns_;
+  std::vector<int64_t> prev_cpu_ns_;
+  std::vector<int64_t> wait_ns_;
+  std::vector<int64_t> prev_wait_ns_;
+  std::vector<int64_t> slices_;
+  std::vector<int64_t> prev_slices_;
+  std::vector<int64_t> time_ns_;
+  std::vector<int64_t> prev_time_ns_;
+  std::vector<int64_t> io_bytes_;
+  std::vector<int64_t> prev_io_bytes_;
+  std::vector<unsigned long> vsize_;  // bytes
+  std::vector<long> rss_;             // pages
+  std::vector<long> start_ticks_;
+  std::vector<float> utilization_;
+  std::vector<float> latency_ns_;
+  std::vector<float> io_rate_;
+  // Sized only with percentiles_, so they cost nothing otherwise
+  std::vector<WindowedSketch> cpu_windows_;
+  std::vector<WindowedSketch> rss_windows_;
+  std::vector<float> sort_values_;
+  std::vector<uint32_t> seen_;  // tick in which the pid was last enumerated
+  std::vector<uint32_t> sampled_;  // tick in which the row was last read
+  std::vector<uint8_t> valid_;
+  std::vector<int> fds_[kFileCount];  // -1 when not held open
+
+  // Cold columns
+  std::vector<uint32_t> uid_;  // effective uid, from /proc/<pid>/status
+  std::vector<StringInterner::Handle> user_;
+  std::vector<StringInterner::Handle> command_;
+  StringInterner strings_;
+  std::unordered_map<uint32_t, StringInterner::Handle> user_names_;  // uid -> name
+
+  std::unordered_map<int, Row> rows_;  // pid -> row
+  std::vector<Row> order_;             // rows by descending utilization
+  std::vector<uint64_t> sort_keys_;
+  std::vector<uint64_t> sort_scratch_;
+  uint32_t tick_{0};
+  bool schedstat_{false};
+  bool io_{false};
+  bool percentiles_{false};
+  uint32_t minute_{0};  // WindowedSketch::MinuteNow() of the last Update
+  std::vector<File> files_;    // read for every sampled row this tick
+  std::vector<Row> read_rows_;  // rows read this tick
+  std::vector<Row> sampled_rows_;  // of those, rows with a new sample
+
+  std::unordered_map<uint32_t, UserUsage> users_;  // uid -> totals
+  std::vector<UserUsage> sorted_users_;
+  SortKey sort_key_{SortKey::kCpu};
+  bool sort_reverse_{false};
+
+  RefreshScheduler scheduler_;
+  std::unique_ptr<ProcReader> reader_{
+      ProcReader::Create(ProcReader::Backend::kPread)};
+  std::vector<ProcReader::Request> requests_;
+  std::vector<char> paths_;    // one NUL-terminated path per request
+  std::vector<char> buffers_;  // one read buffer per request
+  int read_threads_{1};
+  size_t open_fds_{0};
+  size_t fd_limit_{DefaultFdLimit()};
+  std::vector<uint64_t> evict_keys_;
+  size_t visible_first_{0};
+  size_t visible_count_{0};
+  std::vector<int> visible_pids_;
+  // Rebuilt by every Update() for the scheduler
+  std::vector<uint8_t> visible_;
+  std::vector<uint8_t> measured_;
+};
+
+#endif
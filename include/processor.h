@@ -3,10 +3,13 @@
 
 class Processor {
  public:
+  void Update();        // Samples /proc/stat; called once per tick
+  void Load(float utilization) { utilization_ = utilization; }
   float Utilization();  // TODO: See src/processor.cpp
 
   // TODO: Declare any necessary private members
  private:
+  float utilization_{0.0};
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,63 @@
+#ifndef REFRESH_SCHEDULER_H
+#define REFRESH_SCHEDULER_H
+
+#include <cstdint>
+#include <vector>
+
+// How often each tier of processes is re-read.
+struct RefreshPolicy {
+  int idle_interval{4};        // idle rows are read every N ticks
+  float hot_threshold{0.005};  // utilization at or above this is hot
+  int budget_ms{0};            // time spent reading per tick, 0 = unlimited
+  int budget_reads{0};         // files read per tick, 0 = unlimited
+};
+
+/*
+Decides which process rows are sampled on a tick and enforces the per-tick
+budget while they are read.
+
+Rows are planned in tiers: rows on screen, new rows (never sampled, or
+with only a baseline sample so far), hot rows, idle rows that missed
+their slot, and finally idle rows whose round-robin slot (pid modulo
+idle_interval) is this tick. The budget cuts the plan off
+from the end, so if it runs out the rows that lose out are the least
+important ones, and they move up to the overdue tier next tick. A row
+that is skipped keeps its previous utilization and is reported as stale.
+Its delta state (previous CPU time and timestamp) stays where it was,
+so the next sample averages over the whole gap.
+*/
+class RefreshScheduler {
+ public:
+  using Row = uint32_t;
+
+  void SetPolicy(const RefreshPolicy& policy) { policy_ = policy; }
+  const RefreshPolicy& Policy() const { return policy_; }
+
+  // `sampled` holds the tick each row was last read in (0 for never);
+  // `measured` is false for rows with no utilization yet.
+  const std::vector<Row>& Plan(uint32_t tick, const std::vector<int>& pids,
+                               const std::vector<float>& utilization,
+                               const std::vector<uint32_t>& sampled,
+                               const std::vector<uint8_t>& visible,
+                               const std::vector<uint8_t>& measured);
+
+  // Call before reading the first planned row.
+  void StartTick();
+  // Accounts `reads` files before they are read; false once this tick's
+  // read budget is spent.
+  bool Spend(int reads);
+  // Call after each batch is read; false once this tick's time budget is
+  // spent. Reads are charged by the clock only after they happen, so a
+  // tick overruns the budget by at most the last batch.
+  bool WithinDeadline();
+
+ private:
+  RefreshPolicy policy_;
+  std::vector<Row> plan_;
+  std::vector<Row> tiers_[5];
+  int64_t deadline_ns_{0};
+  int reads_{0};
+  bool exhausted_{false};
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <cstdint>
+
+/*
+Fixed-size quantile sketch in the style of DDSketch.
+
+Values are counted in logarithmic buckets, so every quantile comes back
+within kRelativeAccuracy of a value actually added. Only kBuckets
+consecutive buckets are kept, spanning a factor of about 600 below the
+largest value: when a larger value arrives, the window slides up and the
+lowest buckets are collapsed into the first one. That keeps the high
+quantiles (p95, p99) accurate at the expense of the low ones; the max is
+kept exactly. Values at or below kMinValue count as zero.
+Sketches merge bucket by bucket, so windows are built by merging slices.
+*/
+class Sketch {
+ public:
+  static constexpr int kBuckets = 32;
+  static constexpr float kRelativeAccuracy = 0.1f;
+  static constexpr float kMinValue = 1e-4f;
+
+  void Add(float value);
+  void Merge(const Sketch& other);
+  void Clear() { *this = Sketch(); }
+
+  bool Empty() const { return max_ < 0.0f; }
+  // 0 <= q <= 1; 0 when empty
+  float Quantile(float q) const;
+  float Max() const { return Empty() ? 0.0f : max_; }
+
+ private:
+  // Shifts the bucket window so `key` is its top bucket.
+  void Raise(int key);
+  void Halve();
+
+  uint16_t counts_[kBuckets] = {};
+  int16_t offset_{INT16_MIN};  // key of counts_[0]; INT16_MIN until used
+  uint16_t zeros_{0};
+  float max_{-1.0f};
+};
+
+// The sliding windows a WindowedSketch answers for
+enum class Window { k1m, k5m, k15m };
+
+/*
+Sketches of one metric over the last 1, 5 and 15 minutes, in constant
+space: the last six one-minute slices and the last three complete
+five-minute slices. A window merges the current slice with the complete
+slices before it, so it spans between N and N plus one slice of history.
+Slices are rotated lazily, by the minute passed to Add() and Query().
+*/
+class WindowedSketch {
+ public:
+  // Minutes on the monotonic clock; the unit slices rotate on
+  static uint32_t MinuteNow();
+
+  void Add(float value, uint32_t minute);
+  Sketch Query(Window window, uint32_t minute);
+
+ private:
+  static constexpr uint32_t kMinutes = 6;
+  static constexpr uint32_t kPeriods = 3;  // five-minute slices
+
+  void Rotate(uint32_t minute);
+
+  Sketch minutes_[kMinutes];  // minute m in slot m % kMinutes
+  Sketch periods_[kPeriods];  // minutes [5p, 5p + 5) in slot p % kPeriods
+  uint32_t minute_{0};        // newest minute rotated to
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class System;
+
+/*
+Snapshots published through a POSIX shared-memory segment so one collector
+can feed any number of local viewers.
+
+The segment is a header followed by a ring of fixed-size slots. Each slot
+is guarded by a sequence number (a seqlock): the writer makes it odd
+while filling the slot and even when done, then advances `latest`.
+Readers copy the latest slot and retry if its sequence changed under them,
+so neither side ever blocks the other.
+*/
+namespace Snapshot {
+constexpr uint32_t kMagic = 0x4d4f4e53;  // "MONS"
+constexpr uint32_t kVersion = 2;
+constexpr uint32_t kSlots = 4;
+
+struct SystemRecord {
+  float cpu_utilization;
+  float memory_utilization;
+  int64_t uptime;
+  int32_t total_processes;
+  int32_t running_processes;
+  char kernel[64];
+  char operating_system[64];
+};
+
+// Strings are truncated, not NUL-terminated when full; use the lengths.
+struct ProcessRecord {
+  int32_t pid;
+  float cpu_utilization;
+  uint32_t uid;
+  float io_rate;  // bytes/s
+  uint64_t vsize;
+  int64_t rss;
+  int64_t start_ticks;
+  uint16_t user_length;
+  uint16_t command_length;
+  char user[32];
+  char command[148];
+};
+
+struct Header {
+  std::atomic<uint32_t> magic;  // set last, once the geometry is valid
+  uint32_t version;
+  uint32_t slot_count;
+  uint32_t max_processes;
+  uint64_t slot_size;
+  std::atomic<uint64_t> latest;  // generation of the newest complete slot
+};
+
+// Followed in the segment by max_processes ProcessRecords
+struct alignas(64) Slot {
+  std::atomic<uint64_t> sequence;  // 2 * generation + 2 once complete
+  SystemRecord system;
+  uint32_t process_count;
+};
+
+// A consistent copy of one slot. Processes are in ranked order.
+struct Data {
+  SystemRecord system{};
+  std::vector<ProcessRecord> processes;
+};
+};  // namespace Snapshot
+
+// Creates (or replaces) the segment `name` and writes one snapshot per
+// Publish(). The segment is unlinked on destruction.
+class SnapshotPublisher {
+ public:
+  // Throws std::runtime_error if the segment can't be created.
+  SnapshotPublisher(const std::string& name, uint32_t max_processes);
+  ~SnapshotPublisher();
+  SnapshotPublisher(const SnapshotPublisher&) = delete;
+  SnapshotPublisher& operator=(const SnapshotPublisher&) = delete;
+
+  // Publishes `system` as of its last Refresh(). Only the busiest
+  // max_processes processes fit.
+  void Publish(System& system);
+
+ private:
+  std::string name_;
+  void* mapping_{nullptr};
+  size_t size_{0};
+  uint64_t generation_{0};
+};
+
+// Read-only view of a segment created by SnapshotPublisher.
+class SnapshotReader {
+ public:
+  // Throws std::runtime_error if the segment is missing or incompatible.
+  explicit SnapshotReader(const std::string& name);
+  ~SnapshotReader();
+  SnapshotReader(const SnapshotReader&) = delete;
+  SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+  // Copies the newest snapshot into `data`. Returns false if nothing has
+  // been published yet.
+  bool Read(Snapshot::Data& data);
+
+ private:
+  const void* mapping_{nullptr};
+  size_t size_{0};
+};
+
+#endif
@@ -1,11 +1,15 @@
 #ifndef SYSTEM_H
 #define SYSTEM_H
 
+#include <chrono>
 #include <string>
 #include <vector>
 
 #include "process.h"
+#include "process_table.h"
 #include "processor.h"
+#include "sketch.h"
+#include "snapshot.h"
 
 class System {
  public:
@@ -14,21 +18,58 @@ class System {
     kernel_ = LinuxParser::Kernel();
     operating_system_ = LinuxParser::OperatingSystem();
   }
+  // Viewer: every Refresh() loads the newest snapshot from `source`
+  // instead of reading /proc.
+  explicit System(SnapshotReader& source) : source_(&source) {}
+  // Samples the CPU, memory, counters and process table once. Everything
+  // below returns the values of the last Refresh().
+  void Refresh();
+  // Takes the baseline sample of the CPU and every process, in parallel,
+  // then waits `prime_ms` so the first Refresh() has deltas to report.
+  // A no-op for viewers.
+  void Prime(int prime_ms);
+  // Records the time from construction to the first frame drawn or
+  // published; later calls are ignored.
+  void MarkFirstFrame();
+  // Negative until MarkFirstFrame()
+  float FirstFrameSeconds() const { return first_frame_seconds_; }
+  // Restricts sampling to `pids` (those still running); empty for all.
+  void SetPidFilter(const std::vector<int>& pids) { pid_filter_ = pids; }
   Processor& Cpu();                   // TODO: See src/system.cpp
-  std::vector<Process>& Processes();  // TODO: See src/system.cpp
+  ProcessTable& Processes();          // TODO: See src/system.cpp
   float MemoryUtilization();          // TODO: See src/system.cpp
   long UpTime();                      // TODO: See src/system.cpp
   int TotalProcesses();               // TODO: See src/system.cpp
   int RunningProcesses();             // TODO: See src/system.cpp
   std::string Kernel();               // TODO: See src/system.cpp
   std::string OperatingSystem();      // TODO: See src/system.cpp
+  // Distribution of the aggregate CPU and memory utilization over `window`
+  Sketch CpuWindow(Window window);
+  Sketch MemoryWindow(Window window);
 
   // TODO: Define any necessary private members
  private:
   Processor cpu_ = {};
-  std::vector<Process> processes_ = {};
+  ProcessTable processes_ = {};
   std::string kernel_;
   std::string operating_system_;
+  float memory_utilization_{0.0};
+  WindowedSketch cpu_window_;
+  WindowedSketch memory_window_;
+  long uptime_{0};
+  int total_processes_{0};
+  int running_processes_{0};
+  std::vector<int> pid_filter_;
+  SnapshotReader* source_{nullptr};
+  std::chrono::steady_clock::time_point started_{
+      std::chrono::steady_clock::now()};
+  float first_frame_seconds_{-1.0f};
+  Snapshot::Data snapshot_;
+  std::vector<ProcessTable::Sample> samples_;
+
+  void Load();
+  std::vector<int> Pids();
+  void AddWindowSamples();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+using std::string_view;
+using std::vector;
+
+namespace {
+constexpr size_t kInternChunkSize = 64 * 1024;
+constexpr size_t kFrameChunkSize = 16 * 1024;
+}  // namespace
+
+StringInterner::StringInterner() { views_.emplace_back(); }
+
+StringInterner::Handle StringInterner::Intern(string_view value) {
+  if (value.empty()) {
+    return kEmpty;
+  }
+  auto it = index_.find(value);
+  if (it != index_.end()) {
+    return it->second;
+  }
+  Handle handle = static_cast<Handle>(views_.size());
+  string_view stored = Store(value);
+  views_.push_back(stored);
+  index_.emplace(stored, handle);
+  return handle;
+}
+
+// Strings larger than a chunk get a chunk of their own.
+string_view StringInterner::Store(string_view value) {
+  if (chunks_.empty() || chunk_used_ + value.size() > chunk_size_) {
+    chunk_size_ = std::max(kInternChunkSize, value.size());
+    chunks_.emplace_back(new char[chunk_size_]);
+    chunk_used_ = 0;
+  }
+  char* dest = chunks_.back().get() + chunk_used_;
+  std::memcpy(dest, value.data(), value.size());
+  chunk_used_ += value.size();
+  return string_view(dest, value.size());
+}
+
+void StringInterner::Retain(const vector<vector<Handle>*>& columns) {
+  StringInterner fresh;
+  vector<Handle> remap(views_.size(), kEmpty);
+  vector<bool> mapped(views_.size(), false);
+  for (vector<Handle>* column : columns) {
+    for (Handle& handle : *column) {
+      if (!mapped[handle]) {
+        remap[handle] = fresh.Intern(views_[handle]);
+        mapped[handle] = true;
+      }
+      handle = remap[handle];
+    }
+  }
+  *this = std::move(fresh);
+}
+
+string_view FrameArena::Format(const char* format, ...) {
+  char scratch[256];
+  va_list args;
+  va_start(args, format);
+  int length = std::vsnprintf(scratch, sizeof(scratch), format, args);
+  va_end(args);
+  if (length < 0) {
+    return string_view();
+  }
+  char* dest = Allocate(length + 1);
+  if (static_cast<size_t>(length) < sizeof(scratch)) {
+    std::memcpy(dest, scratch, length + 1);
+  } else {
+    va_start(args, format);
+    std::vsnprintf(dest, length + 1, format, args);
+    va_end(args);
+  }
+  return string_view(dest, length);
+}
+
+// Once a frame has spilled into several chunks they are replaced by one
+// chunk big enough for all of them, so steady state is a single buffer.
+void FrameArena::Reset() {
+  if (chunks_.size() > 1) {
+    size_t total = chunk_size_ * chunks_.size();
+    chunks_.clear();
+    chunks_.emplace_back(new char[total]);
+    chunk_size_ = total;
+  }
+  used_ = 0;
+}
+
+char* FrameArena::Allocate(size_t size) {
+  if (chunks_.empty() || used_ + size > chunk_size_) {
+    chunk_size_ = std::max(std::max(chunk_size_, kFrameChunkSize), size);
+    chunks_.emplace_back(new char[chunk_size_]);
+    used_ = 0;
+  }
+  char* dest = chunks_.back().get() + used_;
+  used_ += size;
+  return dest;
+}
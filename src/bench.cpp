@@ -0,0 +1,87 @@
+#include "bench.h"
+
+#include <sys/resource.h>
+#include <time.h>
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "linux_parser.h"
+#include "proc_reader.h"
+
+using std::vector;
+
+namespace {
+constexpr int kPasses = 5;
+constexpr size_t kPathSize = 32;
+constexpr size_t kBufferSize = 1024;
+
+double Seconds(const timeval& time) {
+  return time.tv_sec + time.tv_usec / 1e6;
+}
+
+double MonotonicSeconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+}  // namespace
+
+int Bench::Run(int files) {
+  vector<int> pids = LinuxParser::Pids();
+  if (pids.empty()) {
+    std::fprintf(stderr, "monitor: no processes to read\n");
+    return 1;
+  }
+  vector<char> paths(files * kPathSize);
+  vector<char> buffers(files * kBufferSize);
+  vector<ProcReader::Request> requests(files);
+
+  std::printf("%d stat files over %zu pids, %d passes\n", files, pids.size(),
+              kPasses);
+  std::printf("%-8s %12s %12s %12s %8s\n", "backend", "wall ms/pass",
+              "user ms/pass", "sys ms/pass", "failed");
+  for (auto backend :
+       {ProcReader::Backend::kPread, ProcReader::Backend::kIoUring}) {
+    std::unique_ptr<ProcReader> reader = ProcReader::Create(backend);
+    const char* name =
+        backend == ProcReader::Backend::kPread ? "pread" : "io_uring";
+    if (reader->Kind() != backend) {
+      std::printf("%-8s unavailable\n", name);
+      continue;
+    }
+    auto reset = [&] {
+      for (int i = 0; i < files; i++) {
+        char* path = &paths[i * kPathSize];
+        std::snprintf(path, kPathSize, "/proc/%d/stat", pids[i % pids.size()]);
+        requests[i] = {path, -1, false, &buffers[i * kBufferSize],
+                       static_cast<uint32_t>(kBufferSize), 0};
+      }
+    };
+    reset();
+    reader->Read(requests.data(), requests.size());  // warm the dentry cache
+
+    rusage before, after;
+    getrusage(RUSAGE_SELF, &before);
+    double start = MonotonicSeconds();
+    int failed = 0;
+    for (int pass = 0; pass < kPasses; pass++) {
+      reset();
+      reader->Read(requests.data(), requests.size());
+      for (const ProcReader::Request& request : requests) {
+        failed += request.result <= 0;
+      }
+    }
+    double wall = MonotonicSeconds() - start;
+    getrusage(RUSAGE_SELF, &after);
+    std::printf("%-8s %12.2f %12.2f %12.2f %8d\n", name,
+                wall * 1e3 / kPasses,
+                (Seconds(after.ru_utime) - Seconds(before.ru_utime)) * 1e3 /
+                    kPasses,
+                (Seconds(after.ru_stime) - Seconds(before.ru_stime)) * 1e3 /
+                    kPasses,
+                failed / kPasses);
+  }
+  return 0;
+}
@@ -26,3 +26,10 @@ string Format::ElapsedTime(long seconds[[maybe_unused]]) {
        << std::setw(2) << std::setfill('0') << seconds_in_ts;
     return ss.str();
 }
+
+// Same HH:MM:SS, formatted into a frame arena instead of a new string
+std::string_view Format::ElapsedTime(long seconds, FrameArena& arena) {
+    return arena.Format("%02ld:%02ld:%02ld", seconds / kSecondsPerHour,
+                        (seconds % kSecondsPerHour) / kSecondsPerMinute,
+                        seconds % kSecondsPerMinute);
+}
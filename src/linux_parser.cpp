@@ -1,6 +1,7 @@
 #include "linux_parser.h"
 
 #include <dirent.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <string>
 #include <vector>
@@ -9,7 +10,9 @@
 #include <sstream>
 #include <fstream>
 #include <tuple>
+#include <unordered_map>
 #include <cassert>
+#include <charconv>
 #include <sys/time.h>
 
 using std::stof;
@@ -159,28 +162,101 @@ long LinuxParser::Jiffies() {
 // TODO: Read and return the number of active jiffies for a PID
 // REMOVE: [[maybe_unused]] once you define the function
 long LinuxParser::ActiveJiffies(int pid) { 
-  // /proc/<pid>/stat
-  // PID (<p_name>) R 255664 256578 255664 34818 256578 4194304 104 0 0 0 0 0 0 0 20 0 1 0 13823196 3346432 265 18446744073709551615 94358669713408 94358669730993 140725682901616 0 0 0 0 0 0 0 0 0 17 0 0 0 0 0 0 94358669744784 94358669746280 94359282098176 140725682906714 140725682906734 140725682906734 140725682909163 0
   // utime (14) - user code time
   // stime (15) - kernel code time
-  // cutime (16) - user code time for proc children
-  // cstime (17) - kernel code time for proc children
-  std::ifstream stream(kProcDirectory + std::to_string(pid) + kStatFilename);
-  string line;
-  if (stream.is_open()) {
-    std::getline(stream, line);
-    std::istringstream linestream(line);
-    string value;
-    
-    for (int i = 0; i < 13; i++) {
-      linestream >> value;
+  // cutime/cstime (16, 17) belong to reaped children, not to this process
+  ProcStat stat = Stat(pid);
+  return stat.utime + stat.stime;
+}
+
+// Reads /proc/<pid>/stat once and decodes every field in ProcStat.
+// PID (<p_name>) R 255664 256578 255664 34818 256578 4194304 104 0 0 0 0 0 0 0 20 0 1 0 13823196 3346432 265 18446744073709551615 ...
+LinuxParser::ProcStat LinuxParser::Stat(int pid) {
+  string path = kProcDirectory + std::to_string(pid) + kStatFilename;
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return ProcStat{};
+  }
+  char buffer[1024];
+  ssize_t length = read(fd, buffer, sizeof(buffer));
+  close(fd);
+  if (length <= 0) {
+    return ProcStat{};
+  }
+  return ParseStatLine(std::string_view(buffer, length));
+}
+
+LinuxParser::ProcStat LinuxParser::ParseStatLine(std::string_view line) {
+  ProcStat stat{};
+  auto fields =
+      ParseStat<kStatState, kStatPpid, kStatUtime, kStatStime, kStatCutime,
+                kStatCstime, kStatNumThreads, kStatStarttime, kStatVsize,
+                kStatRss>(line);
+  if (!fields) {
+    return stat;
+  }
+  auto [state, ppid, utime, stime, cutime, cstime, num_threads, starttime,
+        vsize, rss] = *fields;
+  stat.valid = true;
+  stat.state = static_cast<char>(state);
+  stat.ppid = ppid;
+  stat.num_threads = num_threads;
+  stat.utime = utime;
+  stat.stime = stime;
+  stat.cutime = cutime;
+  stat.cstime = cstime;
+  stat.starttime = starttime;
+  stat.vsize = vsize;
+  stat.rss = rss;
+  return stat;
+}
+
+// 72271848 67878579 241
+LinuxParser::SchedStat LinuxParser::ParseSchedstatLine(std::string_view line) {
+  SchedStat stat{};
+  const char* p = line.data();
+  const char* end = p + line.size();
+  unsigned long long* fields[] = {&stat.run_ns, &stat.wait_ns,
+                                  &stat.timeslices};
+  for (unsigned long long* field : fields) {
+    auto [next, error] = std::from_chars(p, end, *field);
+    if (error != std::errc()) {
+      return SchedStat{};
     }
-    
-    long utime, stime, cutime, cstime;
-    linestream >> utime >> stime >> cutime >> cstime;
-    return utime + stime + cutime + cstime;
+    p = next < end ? next + 1 : next;
   }
-  return 0;
+  stat.valid = true;
+  return stat;
+}
+
+LinuxParser::IoStat LinuxParser::ParseIo(std::string_view text) {
+  IoStat io{};
+  int found = 0;
+  while (!text.empty()) {
+    size_t end = text.find('\n');
+    std::string_view line = text.substr(0, end);
+    text = end == std::string_view::npos ? std::string_view()
+                                         : text.substr(end + 1);
+    size_t colon = line.find(": ");
+    if (colon == std::string_view::npos) continue;
+    std::string_view key = line.substr(0, colon);
+    unsigned long long* field = key == "read_bytes"    ? &io.read_bytes
+                                : key == "write_bytes" ? &io.write_bytes
+                                                       : nullptr;
+    if (field && std::from_chars(line.data() + colon + 2,
+                                 line.data() + line.size(), *field)
+                         .ec == std::errc()) {
+      found++;
+    }
+  }
+  io.valid = found == 2;
+  return io;
+}
+
+// sysconf is a libc call; the value can't change while we run.
+long LinuxParser::ClockTicks() {
+  static const long ticks = sysconf(_SC_CLK_TCK);
+  return ticks;
 }
 
 /* /proc/stat 
@@ -356,7 +432,7 @@ string LinuxParser::Command(int pid) {
 
 // TODO: Read and return the memory used by a process
 // REMOVE: [[maybe_unused]] once you define the function
-string LinuxParser::Ram(int pid) {
+long LinuxParser::Ram(int pid) {
   std::ifstream stream(kProcDirectory + std::to_string(pid) + kStatusFilename);
   string line;
   if (stream.is_open()) {
@@ -365,11 +441,11 @@ string LinuxParser::Ram(int pid) {
         std::istringstream linestream(line);
         string key, value, unit;
         linestream >> key >> value >> unit;
-        return std::to_string(std::stol(value) / 1024);
+        return std::stol(value) / 1024;
       }
     }
   }
-  return string();
+  return 0;
 }
 
 // TODO: Read and return the user ID associated with a process
@@ -390,12 +466,40 @@ string LinuxParser::Uid(int pid) {
   return string();
 }
 
+// Second field of the Uid: line; the first is the real uid
+string LinuxParser::EffectiveUid(int pid) {
+  std::ifstream stream(kProcDirectory + std::to_string(pid) + kStatusFilename);
+  string line;
+  if (stream.is_open()) {
+    while (std::getline(stream, line)) {
+      if (line.substr(0, 4) == "Uid:") {
+        std::istringstream linestream(line);
+        string key, real, effective;
+        linestream >> key >> real >> effective;
+        return effective;
+      }
+    }
+  }
+  return string();
+}
+
 // TODO: Read and return the user associated with a process
 // REMOVE: [[maybe_unused]] once you define the function
 string LinuxParser::User(int pid) {
-  string uid = Uid(pid);
+  return UserName(Uid(pid));
+}
+
+// Resolves a uid through /etc/passwd. Names are cached since the same few
+// uids own nearly every process and the passwd scan is linear.
+string LinuxParser::UserName(const string& uid) {
+  static std::unordered_map<string, string> names;
+  auto cached = names.find(uid);
+  if (cached != names.end()) {
+    return cached->second;
+  }
   std::ifstream stream(kPasswordPath);
   string line;
+  string user;
   if (stream.is_open()) {
     while (std::getline(stream, line)) {
       string name, x, id;
@@ -403,31 +507,22 @@ string LinuxParser::User(int pid) {
       std::istringstream linestream(line);
       linestream >> name >> x >> id;
       if (id == uid) {
-        return name;
+        user = name;
+        break;
       }
     }
   }
-  return string();
+  names[uid] = user;
+  return user;
 }
 
 // TODO: Read and return the uptime of a process
 // REMOVE: [[maybe_unused]] once you define the function
 long LinuxParser::UpTime(int pid) {
-  std::ifstream stream(kProcDirectory + std::to_string(pid) + kStatFilename);
-  string line;
-  if (stream.is_open()) {
-    std::getline(stream, line);
-    std::istringstream linestream(line);
-
-    string value;
-    for (int i = 0; i < 21; i++) {
-      linestream >> value;
-    }
-    // Read starttime (22nd value)
-    linestream >> value;
-    long starttime = std::stol(value);
-    // Convert to seconds and subtract from system uptime
-    return UpTime() - (starttime / sysconf(_SC_CLK_TCK));
+  ProcStat stat = Stat(pid);
+  if (!stat.valid) {
+    return 0;
   }
-  return 0;
+  // Convert to seconds and subtract from system uptime
+  return UpTime() - (stat.starttime / ClockTicks());
 }
@@ -1,8 +1,18 @@
+#include <chrono>
+#include <csignal>
 #include <cstdlib>
+#include <iostream>
+#include <memory>
 #include <signal.h>
+#include <stdexcept>
+#include <thread>
 
 
+#include "bench.h"
+#include "metrics_exporter.h"
 #include "ncurses_display.h"
+#include "options.h"
+#include "snapshot.h"
 #include "system.h"
 
   // For some reason ctl-c is being ignored (probably ncurses)
@@ -10,8 +20,80 @@
         std::exit(1); 
   }
 
-int main() {
-  signal(SIGINT, signal_handler);
+namespace {
+volatile std::sig_atomic_t stop_daemon = 0;
+
+void stop_handler(int signal_number[[maybe_unused]]) { stop_daemon = 1; }
+
+// Samples once per interval and republishes; scrapes are served from the
+// exporter's thread. Returns on SIGINT/SIGTERM so the socket and segment
+// are cleaned up.
+int RunDaemon(System& system, const Options& options) {
+  signal(SIGINT, stop_handler);
+  signal(SIGTERM, stop_handler);
+  try {
+    std::unique_ptr<MetricsExporter> exporter;
+    if (options.listen_port != 0 || !options.listen_unix.empty()) {
+      exporter = std::make_unique<MetricsExporter>(options.listen_port,
+                                                   options.listen_unix);
+    }
+    std::unique_ptr<SnapshotPublisher> publisher;
+    if (!options.publish.empty()) {
+      publisher = std::make_unique<SnapshotPublisher>(
+          options.publish, options.shm_max_processes);
+    }
+    while (!stop_daemon) {
+      system.Refresh();
+      system.MarkFirstFrame();
+      if (exporter) exporter->Publish(system);
+      if (publisher) publisher->Publish(system);
+      std::this_thread::sleep_for(
+          std::chrono::milliseconds(options.interval_ms));
+    }
+  } catch (const std::runtime_error& error) {
+    std::cerr << "monitor: " << error.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options = ParseOptions(argc, argv);
+  if (options.bench_files > 0) {
+    return Bench::Run(options.bench_files);
+  }
+  if (!options.attach.empty()) {
+    std::unique_ptr<SnapshotReader> reader;
+    try {
+      reader = std::make_unique<SnapshotReader>(options.attach);
+    } catch (const std::runtime_error& error) {
+      std::cerr << "monitor: " << error.what() << "\n";
+      return 1;
+    }
+    System system(*reader);
+    signal(SIGINT, signal_handler);
+    NCursesDisplay::Display(system, options.interval_ms);
+    return 0;
+  }
   System system;
-  NCursesDisplay::Display(system);
+  system.SetPidFilter(options.pids);
+  system.Processes().SetSchedstat(options.schedstat);
+  system.Processes().SetIo(options.io);
+  system.Processes().SetPercentiles(options.percentiles);
+  system.Processes().SetRefreshPolicy(options.refresh);
+  if (options.io_uring) {
+    system.Processes().SetIoBackend(ProcReader::Backend::kIoUring);
+  }
+  if (options.max_fds >= 0) {
+    system.Processes().SetFdLimit(options.max_fds);
+  }
+  if (options.prime_ms > 0) {
+    system.Prime(options.prime_ms);
+  }
+  if (options.daemon) {
+    return RunDaemon(system, options);
+  }
+  signal(SIGINT, signal_handler);
+  NCursesDisplay::Display(system, options.interval_ms);
 }
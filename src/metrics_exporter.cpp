@@ -0,0 +1,448 @@
+#include "metrics_exporter.h"
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "process_table.h"
+#include "system.h"
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace {
+constexpr size_t kMaxRequestSize = 8 * 1024;
+constexpr size_t kMaxCommandLabel = 200;
+constexpr int kBacklog = 64;
+
+[[noreturn]] void Fail(const string& what) {
+  throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+int ListenTcp(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) Fail("socket");
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+      listen(fd, kBacklog) < 0) {
+    int error = errno;
+    close(fd);
+    errno = error;
+    Fail("listen on 127.0.0.1:" + std::to_string(port));
+  }
+  return fd;
+}
+
+// A stale socket file left by a previous run would make bind fail.
+int ListenUnix(const string& path) {
+  sockaddr_un addr{};
+  if (path.size() >= sizeof(addr.sun_path)) {
+    errno = ENAMETOOLONG;
+    Fail("listen on " + path);
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) Fail("socket");
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+  unlink(path.c_str());
+  if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+      listen(fd, kBacklog) < 0) {
+    int error = errno;
+    close(fd);
+    errno = error;
+    Fail("listen on " + path);
+  }
+  return fd;
+}
+
+string HttpResponse(string_view status, string_view content_type,
+                    string_view body) {
+  string response;
+  response.reserve(body.size() + 160);
+  response.append("HTTP/1.1 ").append(status);
+  response.append("\r\nContent-Type: ").append(content_type);
+  response.append("\r\nContent-Length: ").append(std::to_string(body.size()));
+  response.append("\r\nConnection: close\r\n\r\n");
+  response.append(body);
+  return response;
+}
+
+const string& NotFound() {
+  static const string response =
+      HttpResponse("404 Not Found", "text/plain", "not found\n");
+  return response;
+}
+
+void AppendHeader(string& out, const char* name, const char* type,
+                  const char* help) {
+  out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+  out.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+}
+
+void AppendValue(string& out, double value) {
+  char buffer[32];
+  int length = std::snprintf(buffer, sizeof(buffer), " %.9g\n", value);
+  out.append(buffer, length);
+}
+
+void AppendSample(string& out, const char* name, double value) {
+  out.append(name);
+  AppendValue(out, value);
+}
+
+// Label values escape \, " and newlines; cmdline NUL separators become
+// spaces.
+void AppendLabelValue(string& out, string_view value, size_t limit) {
+  while (!value.empty() && value.back() == '\0') {
+    value.remove_suffix(1);
+  }
+  value = value.substr(0, limit);
+  for (char c : value) {
+    switch (c) {
+      case '\\': out.append("\\\\"); break;
+      case '"': out.append("\\\""); break;
+      case '\n': out.append("\\n"); break;
+      case '\0': out.push_back(' '); break;
+      default: out.push_back(c);
+    }
+  }
+}
+
+// Per-process gauges, one labelled sample per process each
+struct ProcessFamily {
+  const char* name;
+  const char* help;
+  double (*value)(const ProcessTable& processes, ProcessTable::Row row);
+};
+
+const ProcessFamily kProcessFamilies[] = {
+    {"monitor_process_cpu_utilization_ratio",
+     "CPU time over wall time during the last tick.",
+     [](const ProcessTable& p, ProcessTable::Row row) -> double {
+       return p.CpuUtilization(row);
+     }},
+    {"monitor_process_virtual_memory_bytes", "Virtual memory size.",
+     [](const ProcessTable& p, ProcessTable::Row row) -> double {
+       return p.Vsize(row);
+     }},
+    {"monitor_process_resident_memory_bytes", "Resident set size.",
+     [](const ProcessTable& p, ProcessTable::Row row) -> double {
+       static const long page_size = sysconf(_SC_PAGESIZE);
+       return static_cast<double>(p.Rss(row)) * page_size;
+     }},
+    {"monitor_process_start_time_seconds", "Start time in seconds after boot.",
+     [](const ProcessTable& p, ProcessTable::Row row) -> double {
+       return static_cast<double>(p.StartTicks(row)) /
+              LinuxParser::ClockTicks();
+     }},
+};
+
+struct WindowLabel {
+  Window window;
+  const char* name;
+};
+
+const WindowLabel kWindows[] = {
+    {Window::k1m, "1m"}, {Window::k5m, "5m"}, {Window::k15m, "15m"}};
+
+struct QuantileLabel {
+  float quantile;
+  const char* name;
+};
+
+const QuantileLabel kQuantiles[] = {
+    {0.5f, "0.5"}, {0.95f, "0.95"}, {0.99f, "0.99"}, {1.0f, "1"}};
+
+// One line per window and quantile of a system-wide sketch
+void AppendWindows(string& out, const char* name, const char* help,
+                   Sketch (System::*sketch)(Window), System& system) {
+  AppendHeader(out, name, "gauge", help);
+  for (const WindowLabel& window : kWindows) {
+    Sketch values = (system.*sketch)(window.window);
+    for (const QuantileLabel& quantile : kQuantiles) {
+      out.append(name).append("{window=\"").append(window.name);
+      out.append("\",quantile=\"").append(quantile.name).append("\"}");
+      AppendValue(out, values.Quantile(quantile.quantile));
+    }
+  }
+}
+
+struct ProcessWindowFamily {
+  const char* name;
+  const char* help;
+  double (*value)(ProcessTable& processes, ProcessTable::Row row,
+                  Window window);
+};
+
+// p99 only, to keep the series count per process bounded
+const ProcessWindowFamily kProcessWindowFamilies[] = {
+    {"monitor_process_cpu_utilization_window_ratio",
+     "p99 CPU utilization over sliding windows (--percentiles only).",
+     [](ProcessTable& p, ProcessTable::Row row, Window window) -> double {
+       return p.CpuWindow(row, window).Quantile(0.99f);
+     }},
+    {"monitor_process_resident_memory_window_bytes",
+     "p99 resident set size over sliding windows (--percentiles only).",
+     [](ProcessTable& p, ProcessTable::Row row, Window window) -> double {
+       static const long page_size = sysconf(_SC_PAGESIZE);
+       return static_cast<double>(p.RssWindow(row, window).Quantile(0.99f)) *
+              page_size;
+     }},
+};
+
+struct UserFamily {
+  const char* name;
+  const char* help;
+  double (*value)(const ProcessTable::UserUsage& usage);
+};
+
+const UserFamily kUserFamilies[] = {
+    {"monitor_user_processes", "Live processes of the user.",
+     [](const ProcessTable::UserUsage& u) -> double { return u.processes; }},
+    {"monitor_user_cpu_utilization_ratio",
+     "Summed CPU utilization of the user's processes.",
+     [](const ProcessTable::UserUsage& u) -> double {
+       return u.cpu_ppm / 1e6;
+     }},
+    {"monitor_user_resident_memory_bytes",
+     "Summed resident set size of the user's processes.",
+     [](const ProcessTable::UserUsage& u) -> double {
+       static const long page_size = sysconf(_SC_PAGESIZE);
+       return static_cast<double>(u.rss) * page_size;
+     }},
+    {"monitor_user_io_bytes_per_second",
+     "Storage bytes read and written per second by the user's processes "
+     "(--io only).",
+     [](const ProcessTable::UserUsage& u) -> double { return u.io_rate; }},
+};
+}  // namespace
+
+struct MetricsExporter::Client {
+  int fd;
+  string request;
+  std::shared_ptr<const string> response;
+  size_t sent{0};
+};
+
+MetricsExporter::MetricsExporter(int port, const string& unix_path)
+    : unix_path_(unix_path) {
+  wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wake_fd_ < 0) Fail("eventfd");
+  try {
+    if (port > 0) {
+      listen_fds_.push_back(ListenTcp(port));
+    }
+    if (!unix_path.empty()) {
+      listen_fds_.push_back(ListenUnix(unix_path));
+    }
+  } catch (...) {
+    for (int fd : listen_fds_) close(fd);
+    close(wake_fd_);
+    throw;
+  }
+  response_ = std::make_shared<const string>(HttpResponse(
+      "503 Service Unavailable", "text/plain", "no sample yet\n"));
+  thread_ = std::thread(&MetricsExporter::Serve, this);
+}
+
+MetricsExporter::~MetricsExporter() {
+  stop_ = true;
+  uint64_t one = 1;
+  [[maybe_unused]] ssize_t written = write(wake_fd_, &one, sizeof(one));
+  thread_.join();
+  for (int fd : listen_fds_) close(fd);
+  close(wake_fd_);
+  if (!unix_path_.empty()) {
+    unlink(unix_path_.c_str());
+  }
+}
+
+void MetricsExporter::Publish(System& system) {
+  body_.clear();
+  Metrics::Render(system, body_);
+  auto response = std::make_shared<const string>(HttpResponse(
+      "200 OK", "text/plain; version=0.0.4; charset=utf-8", body_));
+  std::lock_guard<std::mutex> lock(mutex_);
+  response_ = std::move(response);
+}
+
+std::shared_ptr<const string> MetricsExporter::Response() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return response_;
+}
+
+// Single-threaded poll loop. Each connection reads one request, gets a
+// reference to the current response and is closed once it is written;
+// a slow client keeps its snapshot alive without blocking Publish().
+void MetricsExporter::Serve() {
+  vector<Client> clients;
+  vector<pollfd> fds;
+  char buffer[4096];
+  while (!stop_) {
+    fds.clear();
+    fds.push_back({wake_fd_, POLLIN, 0});
+    for (int fd : listen_fds_) {
+      fds.push_back({fd, POLLIN, 0});
+    }
+    for (const Client& client : clients) {
+      fds.push_back(
+          {client.fd, static_cast<short>(client.response ? POLLOUT : POLLIN),
+           0});
+    }
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      continue;  // EINTR
+    }
+
+    size_t first_client = 1 + listen_fds_.size();
+    for (size_t i = 1; i < first_client; i++) {
+      if (!(fds[i].revents & POLLIN)) continue;
+      int fd;
+      while ((fd = accept4(fds[i].fd, nullptr, nullptr,
+                           SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        clients.push_back({fd, string(), nullptr, 0});
+      }
+    }
+
+    // Only clients that existed when fds was built have an entry in it
+    size_t polled = fds.size() - first_client;
+    for (size_t i = 0; i < polled; i++) {
+      Client& client = clients[i];
+      short revents = fds[first_client + i].revents;
+      bool done = revents & (POLLERR | POLLNVAL);
+      if (!done && !client.response && (revents & (POLLIN | POLLHUP))) {
+        ssize_t n = read(client.fd, buffer, sizeof(buffer));
+        if (n <= 0) {
+          done = n == 0 || errno != EAGAIN;
+        } else {
+          client.request.append(buffer, n);
+          if (client.request.find("\r\n\r\n") != string::npos ||
+              client.request.find("\n\n") != string::npos) {
+            bool metrics = client.request.rfind("GET /metrics ", 0) == 0 ||
+                           client.request.rfind("GET / ", 0) == 0;
+            client.response =
+                metrics ? Response()
+                        : std::shared_ptr<const string>(&NotFound(),
+                                                        [](const string*) {});
+          } else if (client.request.size() > kMaxRequestSize) {
+            done = true;
+          }
+        }
+      }
+      if (!done && client.response && (revents & POLLOUT)) {
+        ssize_t n = write(client.fd, client.response->data() + client.sent,
+                          client.response->size() - client.sent);
+        if (n < 0) {
+          done = errno != EAGAIN;
+        } else {
+          client.sent += n;
+          done = client.sent == client.response->size();
+        }
+      }
+      if (done) {
+        close(client.fd);
+        client.fd = -1;
+      }
+    }
+    clients.erase(std::remove_if(clients.begin(), clients.end(),
+                                 [](const Client& c) { return c.fd < 0; }),
+                  clients.end());
+  }
+  for (const Client& client : clients) {
+    close(client.fd);
+  }
+}
+
+void Metrics::Render(System& system, string& out) {
+  AppendHeader(out, "monitor_cpu_utilization_ratio", "gauge",
+               "Aggregate CPU utilization over the last tick.");
+  AppendSample(out, "monitor_cpu_utilization_ratio",
+               system.Cpu().Utilization());
+  AppendHeader(out, "monitor_memory_utilization_ratio", "gauge",
+               "(MemTotal - MemFree) / MemTotal.");
+  AppendSample(out, "monitor_memory_utilization_ratio",
+               system.MemoryUtilization());
+  AppendHeader(out, "monitor_uptime_seconds", "gauge",
+               "Seconds since boot.");
+  AppendSample(out, "monitor_uptime_seconds", system.UpTime());
+  AppendHeader(out, "monitor_time_to_first_frame_seconds", "gauge",
+               "Seconds from startup to the first published sample.");
+  AppendSample(out, "monitor_time_to_first_frame_seconds",
+               system.FirstFrameSeconds());
+  AppendHeader(out, "monitor_forks_total", "counter",
+               "Processes created since boot.");
+  AppendSample(out, "monitor_forks_total", system.TotalProcesses());
+  AppendHeader(out, "monitor_processes", "gauge", "Processes in /proc.");
+  AppendSample(out, "monitor_processes", system.RunningProcesses());
+  AppendWindows(out, "monitor_cpu_utilization_window_ratio",
+                "Quantiles of the aggregate CPU utilization over sliding "
+                "windows.",
+                &System::CpuWindow, system);
+  AppendWindows(out, "monitor_memory_utilization_window_ratio",
+                "Quantiles of the memory utilization over sliding windows.",
+                &System::MemoryWindow, system);
+
+  ProcessTable& processes = system.Processes();
+  for (const ProcessFamily& family : kProcessFamilies) {
+    AppendHeader(out, family.name, "gauge", family.help);
+    for (size_t rank = 0; rank < processes.Size(); rank++) {
+      ProcessTable::Row row = processes.Ranked(rank);
+      out.append(family.name).append("{pid=\"");
+      out.append(std::to_string(processes.Pid(row)));
+      out.append("\",user=\"");
+      // Both are loaded once per process and cached with the row, so the
+      // labels of a series never change
+      AppendLabelValue(out, processes.User(row), kMaxCommandLabel);
+      out.append("\",command=\"");
+      AppendLabelValue(out, processes.Command(row), kMaxCommandLabel);
+      out.append("\"}");
+      AppendValue(out, family.value(processes, row));
+    }
+  }
+
+  if (processes.Percentiles()) {
+    for (const ProcessWindowFamily& family : kProcessWindowFamilies) {
+      AppendHeader(out, family.name, "gauge", family.help);
+      for (size_t rank = 0; rank < processes.Size(); rank++) {
+        ProcessTable::Row row = processes.Ranked(rank);
+        for (const WindowLabel& window : kWindows) {
+          out.append(family.name).append("{pid=\"");
+          out.append(std::to_string(processes.Pid(row)));
+          out.append("\",window=\"").append(window.name).append("\"}");
+          AppendValue(out, family.value(processes, row, window.window));
+        }
+      }
+    }
+  }
+
+  const vector<ProcessTable::UserUsage>& users = processes.Users();
+  for (const UserFamily& family : kUserFamilies) {
+    AppendHeader(out, family.name, "gauge", family.help);
+    for (const ProcessTable::UserUsage& usage : users) {
+      out.append(family.name).append("{uid=\"");
+      out.append(std::to_string(usage.uid));
+      out.append("\",user=\"");
+      AppendLabelValue(out, usage.name, kMaxCommandLabel);
+      out.append("\"}");
+      AppendValue(out, family.value(usage));
+    }
+  }
+}
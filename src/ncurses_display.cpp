@@ -1,16 +1,32 @@
 #include <curses.h>
+#include <unistd.h>
+#include <algorithm>
 #include <chrono>
 #include <string>
-#include <thread>
+#include <string_view>
 #include <vector>
 
+#include "arena.h"
 #include "format.h"
 #include "ncurses_display.h"
 #include "system.h"
 
 using std::string;
+using std::string_view;
 using std::to_string;
 
+namespace {
+constexpr int kSystemHeight = 10;
+
+// Strings formatted for the current frame; reset once it is on screen.
+FrameArena frame;
+
+// Views are not NUL-terminated, so they are written with an explicit length.
+void Print(WINDOW* window, int row, int column, string_view text) {
+  mvwaddnstr(window, row, column, text.data(), text.size());
+}
+}  // namespace
+
 // 50 bars uniformly displayed from 0 - 100 %
 // 2% is one bar(|)
 std::string NCursesDisplay::ProgressBar(float percent) {
@@ -49,61 +65,365 @@ void NCursesDisplay::DisplaySystem(System& system, WINDOW* window) {
       ("Running Processes: " + to_string(system.RunningProcesses())).c_str());
   mvwprintw(window, ++row, 2,
             ("Up Time: " + Format::ElapsedTime(system.UpTime())).c_str());
+  if (system.FirstFrameSeconds() >= 0) {
+    Print(window, row, 30,
+          frame.Format("First frame: %.0f ms",
+                       system.FirstFrameSeconds() * 1000));
+  }
+  float cpu[3], memory[3];
+  for (Window span : {Window::k1m, Window::k5m, Window::k15m}) {
+    int i = static_cast<int>(span);
+    cpu[i] = system.CpuWindow(span).Quantile(0.99f) * 100;
+    memory[i] = system.MemoryWindow(span).Quantile(0.99f) * 100;
+  }
+  Print(window, ++row, 2,
+        frame.Format("p99 over 1m/5m/15m  CPU: %.1f/%.1f/%.1f%%  "
+                     "Memory: %.1f/%.1f/%.1f%%",
+                     cpu[0], cpu[1], cpu[2], memory[0], memory[1], memory[2]));
   wrefresh(window);
 }
 
-void NCursesDisplay::DisplayProcesses(std::vector<Process>& processes,
-                                      WINDOW* window, int n) {
+void NCursesDisplay::DisplayProcesses(ProcessTable& processes,
+                                      WINDOW* window, size_t first,
+                                      int highlight) {
+  using SortKey = ProcessTable::SortKey;
   int row{0};
   int const pid_column{2};
   int const user_column{9};
   int const cpu_column{16};
   int const ram_column{26};
   int const time_column{35};
-  int const command_column{46};
+  // Optional columns follow TIME+ in this order
+  int column{46};
+  int const latency_column{column};
+  column += processes.Schedstat() ? 9 : 0;
+  int const p99_column{column};
+  column += processes.Percentiles() ? 9 : 0;
+  int const command_column{column};
+  int const width{getmaxx(window) - 1};
+  // Header and both borders take three lines
+  size_t const height = std::max(getmaxy(window) - 3, 0);
+  size_t const last = std::min(first + height, processes.Size());
+  // The sorted column's title is underlined
+  auto title = [&](int column, const char* text, SortKey key) {
+    if (processes.Sort() == key) wattron(window, A_UNDERLINE);
+    mvwaddstr(window, row, column, text);
+    wattroff(window, A_UNDERLINE);
+  };
   wattron(window, COLOR_PAIR(2));
-  mvwprintw(window, ++row, pid_column, "PID");
+  ++row;
+  title(pid_column, "PID", SortKey::kPid);
   mvwprintw(window, row, user_column, "USER");
-  mvwprintw(window, row, cpu_column, "CPU[%%]");
-  mvwprintw(window, row, ram_column, "RAM[MB]");
-  mvwprintw(window, row, time_column, "TIME+");
+  title(cpu_column, "CPU[%]", SortKey::kCpu);
+  title(ram_column, "RAM[MB]", SortKey::kMemory);
+  title(time_column, "TIME+", SortKey::kTime);
+  if (processes.Schedstat()) {
+    title(latency_column, "LAT[ms]", SortKey::kLatency);
+  }
+  if (processes.Percentiles()) {
+    title(p99_column, "P99/5m", SortKey::kCpuP99);
+  }
   mvwprintw(window, row, command_column, "COMMAND");
   wattroff(window, COLOR_PAIR(2));
-  for (int i = 0; i < n; ++i) {
-    mvwprintw(window, ++row, pid_column, to_string(processes[i].Pid()).c_str());
-    mvwprintw(window, row, user_column, processes[i].User().c_str());
-    float cpu = processes[i].CpuUtilization() * 100;
-    mvwprintw(window, row, cpu_column, to_string(cpu).substr(0, 4).c_str());
-    mvwprintw(window, row, ram_column, processes[i].Ram().c_str());
-    mvwprintw(window, row, time_column,
-              Format::ElapsedTime(processes[i].UpTime()).c_str());
-    mvwprintw(window, row, command_column,
-              processes[i].Command().substr(0, window->_maxx - 46).c_str());
+  // Only the rows on screen are formatted, and only they load their
+  // command and user
+  processes.SetVisible(first, height);
+  for (size_t rank = first; rank < last; ++rank) {
+    Process process = processes.At(rank);
+    ++row;
+    if (process.Pid() == highlight) wattron(window, A_REVERSE);
+    Print(window, row, pid_column, frame.Format("%d", process.Pid()));
+    Print(window, row, user_column, process.User());
+    float cpu = process.CpuUtilization() * 100;
+    Print(window, row, cpu_column,
+          frame.Format("%.4s%s", frame.Format("%.4f", cpu).data(),
+                       process.Stale() ? "~" : ""));
+    Print(window, row, ram_column, frame.Format("%ld", process.Ram()));
+    Print(window, row, time_column,
+          Format::ElapsedTime(process.UpTime(), frame));
+    if (processes.Schedstat() && process.Latency() >= 0) {
+      Print(window, row, latency_column,
+            frame.Format("%.3f", process.Latency() / 1e6));
+    }
+    if (processes.Percentiles()) {
+      Sketch cpu_window =
+          processes.CpuWindow(processes.Ranked(rank), Window::k5m);
+      Print(window, row, p99_column,
+            frame.Format("%.2f", cpu_window.Quantile(0.99f) * 100));
+    }
+    if (width > command_column) {
+      Print(window, row, command_column,
+            process.Command().substr(0, width - command_column));
+    }
+    wattroff(window, A_REVERSE);
+  }
+}
+
+void NCursesDisplay::DisplayUsers(ProcessTable& processes, WINDOW* window,
+                                  size_t first) {
+  using SortKey = ProcessTable::SortKey;
+  static const long page_size = sysconf(_SC_PAGESIZE);
+  int row{0};
+  int const user_column{2};
+  int const count_column{14};
+  int const cpu_column{22};
+  int const rss_column{32};
+  int const io_column{42};
+  size_t const height = std::max(getmaxy(window) - 3, 0);
+  const std::vector<ProcessTable::UserUsage>& users = processes.Users();
+  size_t const last = std::min(first + height, users.size());
+  auto title = [&](int column, const char* text, bool sorted) {
+    if (sorted) wattron(window, A_UNDERLINE);
+    mvwaddstr(window, row, column, text);
+    wattroff(window, A_UNDERLINE);
+  };
+  wattron(window, COLOR_PAIR(2));
+  ++row;
+  title(user_column, "USER", processes.Sort() == SortKey::kPid);
+  title(count_column, "PROCS", false);
+  title(cpu_column, "CPU[%]",
+        processes.Sort() != SortKey::kMemory &&
+            processes.Sort() != SortKey::kPid);
+  title(rss_column, "RSS[MB]", processes.Sort() == SortKey::kMemory);
+  if (processes.Io()) {
+    title(io_column, "IO[KB/s]", false);
+  }
+  wattroff(window, COLOR_PAIR(2));
+  // No process rows are on screen
+  processes.SetVisible(0, 0);
+  for (size_t rank = first; rank < last; ++rank) {
+    const ProcessTable::UserUsage& usage = users[rank];
+    Print(window, ++row, user_column,
+          string_view(usage.name).substr(0, count_column - user_column - 1));
+    Print(window, row, count_column, frame.Format("%d", usage.processes));
+    Print(window, row, cpu_column,
+          frame.Format("%.2f", usage.cpu_ppm / 1e4));
+    Print(window, row, rss_column,
+          frame.Format("%ld", usage.rss * page_size >> 20));
+    if (processes.Io()) {
+      Print(window, row, io_column,
+            frame.Format("%.1f", usage.io_rate / 1024.0));
+    }
   }
 }
 
-void NCursesDisplay::Display(System& system, int n) {
+namespace {
+// Keyboard state of the process list between frames
+struct ListView {
+  size_t first{0};      // rank shown on the top line
+  int highlight{-1};    // pid of the last search match
+  bool typing{false};   // reading a search query
+  bool users{false};    // per-user totals instead of processes
+  std::string query;
+};
+
+size_t Rows(const ListView& view, ProcessTable& processes) {
+  return view.users ? processes.Users().size() : processes.Size();
+}
+
+// Clamps the scroll position so the last page is full.
+void Scroll(ListView& view, long delta, size_t size, size_t height) {
+  long first = static_cast<long>(view.first) + delta;
+  long max_first =
+      std::max(static_cast<long>(size) - static_cast<long>(height), 0L);
+  view.first = std::clamp(first, 0L, max_first);
+}
+
+void Search(ListView& view, ProcessTable& processes, size_t from) {
+  size_t rank = processes.Find(view.query, from);
+  if (rank < processes.Size()) {
+    view.first = rank;
+    view.highlight = processes.At(rank).Pid();
+  }
+}
+
+// Applies one key press. Returns false to quit.
+bool HandleKey(ListView& view, ProcessTable& processes, int key,
+               size_t height) {
+  using SortKey = ProcessTable::SortKey;
+  const size_t size = Rows(view, processes);
+  const long page = std::max<long>(height, 1);
+  if (view.typing) {
+    if (key == '\n' || key == KEY_ENTER) {
+      view.typing = false;
+      Search(view, processes, view.first);
+    } else if (key == 27) {  // Esc
+      view.typing = false;
+    } else if (key == KEY_BACKSPACE || key == 127 || key == '\b') {
+      if (!view.query.empty()) view.query.pop_back();
+    } else if (key >= ' ' && key < 127) {
+      view.query += static_cast<char>(key);
+    }
+    return true;
+  }
+  auto sort = [&](SortKey sort_key) {
+    processes.SetSort(sort_key, false);
+    view.first = 0;
+  };
+  switch (key) {
+    case 'q':
+      return false;
+    case KEY_UP:
+    case 'k':
+      Scroll(view, -1, size, height);
+      break;
+    case KEY_DOWN:
+    case 'j':
+      Scroll(view, 1, size, height);
+      break;
+    case KEY_PPAGE:
+      Scroll(view, -page, size, height);
+      break;
+    case KEY_NPAGE:
+    case ' ':
+      Scroll(view, page, size, height);
+      break;
+    case KEY_HOME:
+    case 'g':
+      view.first = 0;
+      break;
+    case KEY_END:
+    case 'G':
+      Scroll(view, static_cast<long>(size), size, height);
+      break;
+    case 'u':
+      view.users = !view.users;
+      view.first = 0;
+      break;
+    case '/':
+      if (view.users) break;
+      view.typing = true;
+      view.query.clear();
+      break;
+    case 'n':
+      if (view.users) break;
+      Search(view, processes, view.first + 1);
+      break;
+    case 'c':
+      sort(SortKey::kCpu);
+      break;
+    case 'm':
+      sort(SortKey::kMemory);
+      break;
+    case 'p':
+      sort(SortKey::kPid);
+      break;
+    case 't':
+      sort(SortKey::kTime);
+      break;
+    case 'P':
+      if (processes.Percentiles()) sort(SortKey::kCpuP99);
+      break;
+    case 'l':
+      if (processes.Schedstat()) sort(SortKey::kLatency);
+      break;
+    case 'r':
+      processes.SetSort(processes.Sort(), !processes.SortReversed());
+      view.first = 0;
+      break;
+  }
+  return true;
+}
+
+// Rank range, or the search prompt, on the bottom border.
+void DisplayStatus(const ListView& view, ProcessTable& processes,
+                   WINDOW* window, size_t height) {
+  int const bottom{getmaxy(window) - 1};
+  int const width{getmaxx(window) - 4};
+  if (width <= 0) return;
+  string_view status;
+  if (view.typing) {
+    status = frame.Format(" /%s_ ", view.query.c_str());
+  } else {
+    size_t size = Rows(view, processes);
+    size_t last = std::min(view.first + height, size);
+    status = frame.Format(" %zu-%zu of %zu %s%s ",
+                          last > view.first ? view.first + 1 : 0, last, size,
+                          view.users ? "users" : "processes",
+                          processes.SortReversed() ? ", reversed" : "");
+  }
+  Print(window, bottom, 2, status.substr(0, width));
+}
+}  // namespace
+
+void NCursesDisplay::Display(System& system, int interval_ms) {
   initscr();      // start ncurses
   noecho();       // do not print input values
   cbreak();       // terminate ncurses on ctrl + c
   start_color();  // enable color
+  curs_set(0);
+  set_escdelay(25);
+  init_pair(1, COLOR_BLUE, COLOR_BLACK);
+  init_pair(2, COLOR_GREEN, COLOR_BLACK);
 
-  int x_max{getmaxx(stdscr)};
-  WINDOW* system_window = newwin(9, x_max - 1, 0, 0);
-  WINDOW* process_window =
-      newwin(3 + n, x_max - 1, system_window->_maxy + 1, 0);
+  // ncurses handles SIGWINCH itself and reports it as KEY_RESIZE
+  WINDOW* system_window{nullptr};
+  WINDOW* process_window{nullptr};
+  auto layout = [&] {
+    if (system_window) delwin(system_window);
+    if (process_window) delwin(process_window);
+    int x_max{std::max(getmaxx(stdscr), 2)};
+    int y_max{getmaxy(stdscr)};
+    system_window = newwin(kSystemHeight, x_max - 1, 0, 0);
+    process_window = newwin(std::max(y_max - kSystemHeight, 3), x_max - 1,
+                            kSystemHeight, 0);
+    keypad(process_window, TRUE);
+    clear();
+    refresh();
+  };
+  layout();
 
-  while (1) {
-    init_pair(1, COLOR_BLUE, COLOR_BLACK);
-    init_pair(2, COLOR_GREEN, COLOR_BLACK);
-    box(system_window, 0, 0);
+  ListView view;
+  ProcessTable& processes = system.Processes();
+  auto draw = [&] {
+    size_t height = std::max(getmaxy(process_window) - 3, 0);
+    Scroll(view, 0, Rows(view, processes), height);
+    werase(process_window);
     box(process_window, 0, 0);
-    DisplaySystem(system, system_window);
-    DisplayProcesses(system.Processes(), process_window, n);
-    wrefresh(system_window);
+    if (view.users) {
+      DisplayUsers(processes, process_window, view.first);
+    } else {
+      DisplayProcesses(processes, process_window, view.first, view.highlight);
+    }
+    DisplayStatus(view, processes, process_window, height);
     wrefresh(process_window);
-    refresh();
-    std::this_thread::sleep_for(std::chrono::seconds(1));
+    frame.Reset();
+  };
+
+  using Clock = std::chrono::steady_clock;
+  bool running = true;
+  while (running) {
+    system.Refresh();
+    // Marked before drawing so the first frame shows its own time; drawing
+    // adds well under a millisecond
+    system.MarkFirstFrame();
+    werase(system_window);
+    box(system_window, 0, 0);
+    DisplaySystem(system, system_window);
+    draw();
+
+    // Keys are handled as they arrive; only the list is redrawn for them,
+    // from the data of the last sample
+    auto next = Clock::now() + std::chrono::milliseconds(interval_ms);
+    while (running) {
+      auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+          next - Clock::now());
+      if (remaining.count() <= 0) break;
+      wtimeout(process_window, static_cast<int>(remaining.count()));
+      int key = wgetch(process_window);
+      if (key == ERR) continue;
+      if (key == KEY_RESIZE) {
+        layout();
+        box(system_window, 0, 0);
+        DisplaySystem(system, system_window);
+      } else {
+        size_t height = std::max(getmaxy(process_window) - 3, 0);
+        running = HandleKey(view, processes, key, height);
+      }
+      draw();
+    }
   }
+  delwin(system_window);
+  delwin(process_window);
   endwin();
-}
\ No newline at end of file
+}
@@ -0,0 +1,132 @@
+#include "options.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using std::string;
+
+namespace {
+[[noreturn]] void Usage(const char* program, const string& error) {
+  if (!error.empty()) {
+    std::cerr << program << ": " << error << "\n";
+  }
+  std::cerr << "usage: " << program << " [options]\n"
+            << "  --interval-ms=N     sampling interval (default 1000)\n"
+            << "  --prime-ms=N        wait after the startup baseline so the "
+               "first frame has\n"
+            << "                      real utilization, 0 to skip (default "
+               "150)\n"
+            << "  --schedstat         CPU time from /proc/<pid>/schedstat, "
+               "with a run-queue latency column\n"
+            << "  --io                storage I/O rates from /proc/<pid>/io\n"
+            << "  --percentiles       per-process p99 CPU and RSS over "
+               "1m/5m/15m\n"
+            << "  --pids=PID[,PID...] only track these processes\n"
+            << "  --idle-interval=N   read idle processes every N ticks "
+               "(default 4)\n"
+            << "  --budget-ms=N       max time reading processes per tick\n"
+            << "  --budget-reads=N    max files read per tick\n"
+            << "  --io-uring          batch /proc reads through io_uring "
+               "(falls back to pread)\n"
+            << "  --max-fds=N         /proc files kept open between ticks "
+               "(default: RLIMIT_NOFILE - 256)\n"
+            << "  --bench[=FILES]     compare read backends over FILES stat "
+               "files (default 100000)\n"
+            << "  --daemon            serve metrics instead of the UI\n"
+            << "  --listen-port=N     serve Prometheus metrics on "
+               "127.0.0.1:N\n"
+            << "  --listen-unix=PATH  serve Prometheus metrics on a Unix "
+               "socket\n"
+            << "  --publish=NAME      publish snapshots to shared memory "
+               "segment NAME\n"
+            << "  --shm-max-processes=N  processes per published snapshot "
+               "(default 32768)\n"
+            << "  --attach=NAME       view snapshots published to NAME "
+               "instead of reading /proc\n";
+  std::exit(error.empty() ? 0 : 2);
+}
+
+int ParseInt(const char* program, const string& flag, const string& value,
+             int min) {
+  try {
+    size_t end;
+    int parsed = std::stoi(value, &end);
+    if (end == value.size() && parsed >= min) {
+      return parsed;
+    }
+  } catch (const std::exception&) {
+  }
+  Usage(program, "invalid value for " + flag + ": " + value);
+}
+}  // namespace
+
+Options ParseOptions(int argc, char* argv[]) {
+  Options options;
+  const char* program = argv[0];
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    string flag = arg.substr(0, arg.find('='));
+    string value = flag.size() < arg.size() ? arg.substr(flag.size() + 1) : "";
+    if (flag == "--help" || flag == "-h") {
+      Usage(program, "");
+    } else if (flag == "--interval-ms") {
+      options.interval_ms = ParseInt(program, flag, value, 1);
+    } else if (flag == "--prime-ms") {
+      options.prime_ms = ParseInt(program, flag, value, 0);
+    } else if (flag == "--schedstat") {
+      options.schedstat = true;
+    } else if (flag == "--io") {
+      options.io = true;
+    } else if (flag == "--percentiles") {
+      options.percentiles = true;
+    } else if (flag == "--pids") {
+      std::istringstream list(value);
+      string pid;
+      while (std::getline(list, pid, ',')) {
+        options.pids.push_back(ParseInt(program, flag, pid, 1));
+      }
+    } else if (flag == "--idle-interval") {
+      options.refresh.idle_interval = ParseInt(program, flag, value, 1);
+    } else if (flag == "--budget-ms") {
+      options.refresh.budget_ms = ParseInt(program, flag, value, 1);
+    } else if (flag == "--budget-reads") {
+      options.refresh.budget_reads = ParseInt(program, flag, value, 1);
+    } else if (flag == "--io-uring") {
+      options.io_uring = true;
+    } else if (flag == "--max-fds") {
+      options.max_fds = ParseInt(program, flag, value, 0);
+    } else if (flag == "--bench") {
+      options.bench_files =
+          value.empty() ? 100000 : ParseInt(program, flag, value, 1);
+    } else if (flag == "--daemon") {
+      options.daemon = true;
+    } else if (flag == "--listen-port") {
+      options.listen_port = ParseInt(program, flag, value, 1);
+    } else if (flag == "--listen-unix") {
+      options.listen_unix = value;
+    } else if (flag == "--publish") {
+      options.publish = value;
+    } else if (flag == "--shm-max-processes") {
+      options.shm_max_processes = ParseInt(program, flag, value, 1);
+    } else if (flag == "--attach") {
+      options.attach = value;
+    } else {
+      Usage(program, "unknown option " + arg);
+    }
+  }
+  bool serves = options.listen_port != 0 || !options.listen_unix.empty() ||
+                !options.publish.empty();
+  if (options.daemon && !serves) {
+    Usage(program,
+          "--daemon needs --listen-port, --listen-unix or --publish");
+  }
+  if (!options.daemon && serves) {
+    Usage(program, "--listen-port, --listen-unix and --publish need --daemon");
+  }
+  if (options.daemon && !options.attach.empty()) {
+    Usage(program, "--attach can't be combined with --daemon");
+  }
+  return options;
+}
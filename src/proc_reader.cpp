@@ -0,0 +1,312 @@
+#include "proc_reader.h"
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+using std::vector;
+using Request = ProcReader::Request;
+
+namespace {
+void Pread(Request& request) {
+  ssize_t n = pread(request.fd, request.buffer, request.capacity, 0);
+  request.result = n < 0 ? -errno : static_cast<int>(n);
+}
+
+void ReadFile(Request& request) {
+  bool opened = request.fd < 0;
+  if (opened) {
+    request.fd = open(request.path, O_RDONLY | O_CLOEXEC);
+    if (request.fd < 0) {
+      request.result = -errno;
+      return;
+    }
+  }
+  Pread(request);
+  if (opened && !request.keep_open) {
+    close(request.fd);
+    request.fd = -1;
+  }
+}
+
+class PreadReader : public ProcReader {
+ public:
+  void Read(Request* requests, size_t count) override {
+    for (size_t i = 0; i < count; i++) {
+      ReadFile(requests[i]);
+    }
+  }
+  Backend Kind() const override { return Backend::kPread; }
+};
+
+constexpr unsigned kRingEntries = 256;
+
+/*
+Minimal io_uring driver: one ring, used synchronously. Each phase fills
+up to kRingEntries SQEs, submits and waits for all of them with a single
+io_uring_enter, then reaps the completions.
+
+If io_uring_enter fails for good, the ring is abandoned: the completions
+of everything the kernel already took are awaited, since it may still
+write into their buffers, and the rest of the batch and every later one
+is read with plain syscalls.
+*/
+class IoUringReader : public ProcReader {
+ public:
+  ~IoUringReader() override {
+    if (sqes_) munmap(sqes_, sqes_size_);
+    if (cq_ring_ && cq_ring_ != sq_ring_) munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_) munmap(sq_ring_, sq_ring_size_);
+    if (ring_fd_ >= 0) close(ring_fd_);
+  }
+
+  // False if io_uring is missing, disabled or too old for OPENAT/CLOSE.
+  bool Init() {
+    io_uring_params params{};
+    ring_fd_ = syscall(__NR_io_uring_setup, kRingEntries, &params);
+    if (ring_fd_ < 0) {
+      return false;
+    }
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+      sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ring_ = Map(sq_ring_size_, IORING_OFF_SQ_RING);
+    if (!sq_ring_) return false;
+    cq_ring_ = single_mmap ? sq_ring_ : Map(cq_ring_size_, IORING_OFF_CQ_RING);
+    if (!cq_ring_) return false;
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(Map(sqes_size_, IORING_OFF_SQES));
+    if (!sqes_) return false;
+
+    char* sq = static_cast<char*>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = static_cast<char*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    sq_entries_ = params.sq_entries;
+    return Supports({IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE});
+  }
+
+  void Read(Request* requests, size_t count) override {
+    for (size_t first = 0; first < count; first += sq_entries_) {
+      size_t last = std::min<size_t>(first + sq_entries_, count);
+      if (failed_) {
+        std::for_each(requests + first, requests + last, ReadFile);
+      } else {
+        ReadChunk(requests, first, last);
+      }
+    }
+  }
+
+  Backend Kind() const override { return Backend::kIoUring; }
+  bool Failed() const override { return failed_; }
+
+ private:
+  enum Phase { kOpen, kRead, kClose };
+
+  void* Map(size_t size, off_t offset) {
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring_fd_, offset);
+    return mapping == MAP_FAILED ? nullptr : mapping;
+  }
+
+  bool Supports(std::initializer_list<int> opcodes) {
+    size_t size = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+    std::unique_ptr<char[]> storage(new char[size]());
+    auto* probe = reinterpret_cast<io_uring_probe*>(storage.get());
+    if (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PROBE, probe,
+                256) < 0) {
+      return false;
+    }
+    for (int opcode : opcodes) {
+      if (opcode > probe->last_op ||
+          !(probe->ops[opcode].flags & IO_URING_OP_SUPPORTED)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Open the files that need it, read everything, close what isn't kept.
+  void ReadChunk(Request* requests, size_t first, size_t last) {
+    close_.assign(last - first, 0);
+    bool submitted =
+        Submit(requests, first, last,
+               [](const Request& r) { return r.fd < 0; },
+               [](io_uring_sqe& sqe, const Request& r) {
+                 sqe.opcode = IORING_OP_OPENAT;
+                 sqe.fd = AT_FDCWD;
+                 sqe.addr = reinterpret_cast<uintptr_t>(r.path);
+                 sqe.open_flags = O_RDONLY | O_CLOEXEC;
+               },
+               [&](Request& r, size_t i, int res) {
+                 r.fd = res < 0 ? -1 : res;
+                 r.result = res < 0 ? res : 0;
+                 close_[i - first] = res >= 0 && !r.keep_open;
+               });
+    if (!submitted) {
+      Finish(requests, first, last, kOpen);
+      return;
+    }
+    submitted =
+        Submit(requests, first, last,
+               [](const Request& r) { return r.fd >= 0; },
+               [](io_uring_sqe& sqe, const Request& r) {
+                 sqe.opcode = IORING_OP_READ;
+                 sqe.fd = r.fd;
+                 sqe.addr = reinterpret_cast<uintptr_t>(r.buffer);
+                 sqe.len = r.capacity;
+                 sqe.off = 0;
+               },
+               [](Request& r, size_t, int res) { r.result = res; });
+    if (!submitted) {
+      Finish(requests, first, last, kRead);
+      return;
+    }
+    submitted =
+        Submit(requests, first, last,
+               [&](const Request& r) { return close_[&r - &requests[first]]; },
+               [](io_uring_sqe& sqe, const Request& r) {
+                 sqe.opcode = IORING_OP_CLOSE;
+                 sqe.fd = r.fd;
+               },
+               [](Request& r, size_t, int) { r.fd = -1; });
+    if (!submitted) {
+      Finish(requests, first, last, kClose);
+    }
+  }
+
+  // Completes the chunk with plain syscalls after the ring failed during
+  // `phase`. What the kernel completed (done_) is kept.
+  void Finish(Request* requests, size_t first, size_t last, Phase phase) {
+    for (size_t i = first; i < last; i++) {
+      Request& r = requests[i];
+      bool done = done_[i - first];
+      if (phase == kOpen && r.fd < 0) {
+        if (!done) ReadFile(r);  // opens, reads, closes unless kept
+        continue;
+      }
+      if (r.fd >= 0 && (phase == kOpen || (phase == kRead && !done))) {
+        Pread(r);
+      }
+      if (close_[i - first] && !(phase == kClose && done)) {
+        close(r.fd);
+        r.fd = -1;
+      }
+    }
+  }
+
+  // One io_uring_enter for every request in [first, last) matching `want`.
+  // False if the ring failed; done_ then marks the requests completed.
+  template <typename Want, typename Prepare, typename Complete>
+  bool Submit(Request* requests, size_t first, size_t last, Want want,
+              Prepare prepare, Complete complete) {
+    done_.assign(last - first, 0);
+    unsigned tail = *sq_tail_;
+    unsigned count = 0;
+    for (size_t i = first; i < last; i++) {
+      if (!want(requests[i])) continue;
+      unsigned index = (tail + count) & sq_mask_;
+      io_uring_sqe& sqe = sqes_[index];
+      std::memset(&sqe, 0, sizeof(sqe));
+      prepare(sqe, requests[i]);
+      sqe.user_data = i;
+      sq_array_[index] = index;
+      count++;
+    }
+    if (count == 0) return true;
+    __atomic_store_n(sq_tail_, tail + count, __ATOMIC_RELEASE);
+
+    unsigned submitted = 0;
+    unsigned reaped = 0;
+    while (reaped < count) {
+      long ret = syscall(__NR_io_uring_enter, ring_fd_, count - submitted,
+                         count - reaped, IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        failed_ = true;
+        break;
+      }
+      if (ret > 0) submitted += ret;
+      reaped += Reap(requests, first, complete);
+    }
+    if (!failed_) return true;
+
+    // Every SQE the kernel consumed gets a completion, and until then it
+    // may still write the request's buffer or open a file
+    unsigned consumed = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) - tail;
+    while (reaped < consumed) {
+      unsigned more = Reap(requests, first, complete);
+      reaped += more;
+      if (more == 0) {
+        struct timespec pause = {0, 100000};
+        nanosleep(&pause, nullptr);  // returning to user space runs the
+                                     // ring's pending task work
+      }
+    }
+    return false;
+  }
+
+  template <typename Complete>
+  unsigned Reap(Request* requests, size_t first, Complete complete) {
+    unsigned head = *cq_head_;
+    unsigned cq_tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    unsigned reaped = 0;
+    for (; head != cq_tail; head++, reaped++) {
+      const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+      complete(requests[cqe.user_data], cqe.user_data, cqe.res);
+      done_[cqe.user_data - first] = 1;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    return reaped;
+  }
+
+  int ring_fd_{-1};
+  void* sq_ring_{nullptr};
+  void* cq_ring_{nullptr};
+  size_t sq_ring_size_{0};
+  size_t cq_ring_size_{0};
+  io_uring_sqe* sqes_{nullptr};
+  size_t sqes_size_{0};
+  unsigned* sq_head_{nullptr};
+  unsigned* sq_tail_{nullptr};
+  unsigned sq_mask_{0};
+  unsigned* sq_array_{nullptr};
+  unsigned* cq_head_{nullptr};
+  unsigned* cq_tail_{nullptr};
+  unsigned cq_mask_{0};
+  io_uring_cqe* cqes_{nullptr};
+  unsigned sq_entries_{0};
+  bool failed_{false};
+  vector<uint8_t> close_;  // per request in the chunk: opened here, not kept
+  vector<uint8_t> done_;   // per request in the chunk: completion reaped
+};
+}  // namespace
+
+std::unique_ptr<ProcReader> ProcReader::Create(Backend backend) {
+  if (backend == Backend::kIoUring) {
+    auto reader = std::make_unique<IoUringReader>();
+    if (reader->Init()) {
+      return reader;
+    }
+  }
+  return std::make_unique<PreadReader>();
+}
@@ -0,0 +1,736 @@
+#include "process_table.h"
+
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "linux_parser.h"
+#include "process.h"
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace {
+constexpr size_t kBatchRows = 256;
+// With --budget-ms, so reading one batch can't overrun the budget by much
+constexpr size_t kTimedBatchRows = 32;
+// Below this many files per thread, spawning threads costs more than it saves
+constexpr size_t kMinRequestsPerThread = 32;
+constexpr const char* kFileNames[] = {"stat", "schedstat", "io"};
+constexpr size_t kPathSize = 32;     // "/proc/<pid>/schedstat"
+constexpr size_t kBufferSize = 1024;  // covers stat up to field 24
+// Descriptors left for ncurses, sockets and metrics clients
+constexpr size_t kReservedFds = 256;
+
+int64_t MonotonicNs() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+}
+
+int64_t CpuPpm(float utilization) { return std::llround(utilization * 1e6); }
+
+// Moves the last element of every column into `row` and shrinks them by one.
+template <typename... Columns>
+void SwapRemove(size_t row, Columns&... columns) {
+  ((columns[row] = std::move(columns.back()), columns.pop_back()), ...);
+}
+}  // namespace
+
+ProcessTable::~ProcessTable() {
+  for (Row row = 0; row < pid_.size(); row++) {
+    CloseFds(row);
+  }
+}
+
+size_t ProcessTable::DefaultFdLimit() {
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+    return 0;
+  }
+  if (limit.rlim_cur == RLIM_INFINITY) {
+    return 1 << 20;
+  }
+  return limit.rlim_cur > kReservedFds ? limit.rlim_cur - kReservedFds : 0;
+}
+
+void ProcessTable::SetFdLimit(size_t limit) {
+  fd_limit_ = limit;
+  EvictFds(0);
+}
+
+void ProcessTable::Prime(const vector<int>& pids, int threads) {
+  read_threads_ = std::max(threads, 1);
+  Update(pids);
+  read_threads_ = 1;
+}
+
+void ProcessTable::Update(const vector<int>& pids) {
+  ++tick_;
+  // Rows move during removal, so remember what was on screen by pid
+  visible_pids_.clear();
+  size_t visible_end = std::min(visible_first_ + visible_count_, order_.size());
+  for (size_t rank = visible_first_; rank < visible_end; rank++) {
+    visible_pids_.push_back(pid_[order_[rank]]);
+  }
+
+  for (int pid : pids) {
+    auto it = rows_.find(pid);
+    if (it == rows_.end()) {
+      AddRow(pid);
+    } else {
+      seen_[it->second] = tick_;
+    }
+  }
+
+  // Walk backwards so swap-removal only pulls in rows already visited
+  for (size_t row = pid_.size(); row-- > 0;) {
+    if (seen_[row] != tick_) {
+      RemoveRow(row);
+    }
+  }
+
+  // A row with only a baseline has no utilization yet; the scheduler reads
+  // it again now rather than in its idle slot
+  measured_.assign(pid_.size(), 0);
+  for (Row row = 0; row < pid_.size(); row++) {
+    measured_[row] = (valid_[row] & kMeasured) != 0;
+  }
+  visible_.assign(pid_.size(), 0);
+  for (int pid : visible_pids_) {
+    auto it = rows_.find(pid);
+    if (it != rows_.end()) {
+      visible_[it->second] = 1;
+    }
+  }
+
+  // Reads go out in batches so a time budget is checked between them
+  files_.assign({kStatFile});
+  if (schedstat_) files_.push_back(kSchedstatFile);
+  if (io_) files_.push_back(kIoFile);
+  const int reads_per_row = files_.size();
+  const vector<Row>& plan =
+      scheduler_.Plan(tick_, pid_, utilization_, sampled_, visible_,
+                      measured_);
+  size_t needed = 0;
+  for (Row row : plan) {
+    for (File file : files_) {
+      needed += fds_[file][row] < 0;
+    }
+  }
+  EvictFds(needed);
+  read_rows_.clear();
+  sampled_rows_.clear();
+  minute_ = WindowedSketch::MinuteNow();
+  scheduler_.StartTick();
+  // Priming with pread gives each thread a batch's worth of rows; batches
+  // stay bounded since the read buffers grow to fit the largest one
+  size_t batch_rows =
+      scheduler_.Policy().budget_ms > 0 ? kTimedBatchRows : kBatchRows;
+  if (reader_->Kind() == ProcReader::Backend::kPread) {
+    batch_rows *= read_threads_;
+  }
+  bool within_budget = true;
+  for (size_t first = 0; first < plan.size() && within_budget;) {
+    size_t last = first;
+    while (last < plan.size() && last - first < batch_rows &&
+           (within_budget = scheduler_.Spend(reads_per_row))) {
+      last++;
+    }
+    ReadRows(plan.data() + first, last - first);
+    first = last;
+    within_budget = within_budget && scheduler_.WithinDeadline();
+  }
+
+  ComputeUtilization();
+  for (Row row : read_rows_) {
+    if (valid_[row] & kAccounted) {
+      AddUsage(row, 1);
+    }
+  }
+  if (percentiles_) {
+    for (Row row : sampled_rows_) {
+      cpu_windows_[row].Add(utilization_[row], minute_);
+      rss_windows_[row].Add(rss_[row], minute_);
+    }
+  }
+  Rank();
+
+  // Every distinct command line seen stays interned until this compaction
+  if (strings_.Size() > 2 * pid_.size() + 1024) {
+    strings_.Retain({&user_, &command_});
+    user_names_.clear();
+  }
+}
+
+void ProcessTable::Load(const vector<Sample>& samples) {
+  ++tick_;
+  size_t size = samples.size();
+  for (Row row = 0; row < pid_.size(); row++) {
+    CloseFds(row);
+  }
+  for (vector<int>& fds : fds_) {
+    fds.assign(size, -1);
+  }
+  rows_.clear();
+  cpu_windows_.assign(percentiles_ ? size : 0, WindowedSketch());
+  rss_windows_.assign(percentiles_ ? size : 0, WindowedSketch());
+  for (auto* column : {&cpu_ns_, &prev_cpu_ns_, &wait_ns_, &prev_wait_ns_,
+                       &slices_, &prev_slices_, &time_ns_, &prev_time_ns_,
+                       &io_bytes_, &prev_io_bytes_}) {
+    column->assign(size, 0);
+  }
+  rss_.resize(size);
+  io_rate_.resize(size);
+  start_ticks_.resize(size);
+  latency_ns_.assign(size, 0.0);
+  pid_.resize(size);
+  vsize_.resize(size);
+  utilization_.resize(size);
+  seen_.assign(size, tick_);
+  sampled_.assign(size, tick_);
+  valid_.assign(size, kCommand | kUid | kUser | kAccounted | kMeasured);
+  uid_.resize(size);
+  users_.clear();
+  user_.resize(size);
+  command_.resize(size);
+  for (Row row = 0; row < size; row++) {
+    const Sample& sample = samples[row];
+    rows_[sample.pid] = row;
+    pid_[row] = sample.pid;
+    utilization_[row] = sample.cpu_utilization;
+    vsize_[row] = sample.vsize;
+    rss_[row] = sample.rss;
+    start_ticks_[row] = sample.start_ticks;
+    io_rate_[row] = sample.io_rate;
+    uid_[row] = sample.uid;
+    user_[row] = strings_.Intern(sample.user);
+    command_[row] = strings_.Intern(sample.command);
+    UserUsage& usage = users_[sample.uid];
+    if (usage.processes++ == 0) {
+      usage.uid = sample.uid;
+      usage.name = sample.user;
+    }
+    AddUsage(row, 1);
+  }
+  Rank();
+  if (strings_.Size() > 2 * size + 1024) {
+    strings_.Retain({&user_, &command_});
+    user_names_.clear();
+  }
+}
+
+void ProcessTable::SetSort(SortKey key, bool reverse) {
+  sort_key_ = key;
+  sort_reverse_ = reverse;
+  Rank();
+}
+
+Process ProcessTable::At(size_t rank) { return Process(this, order_[rank]); }
+
+size_t ProcessTable::Find(string_view text, size_t from) {
+  const size_t size = order_.size();
+  if (text.empty() || size == 0) {
+    return size;
+  }
+  for (size_t i = 0; i < size; i++) {
+    size_t rank = (from + i) % size;
+    Row row = order_[rank];
+    if (std::to_string(pid_[row]) == text ||
+        Command(row).find(text) != string_view::npos) {
+      return rank;
+    }
+  }
+  return size;
+}
+
+string_view ProcessTable::Command(Row row) {
+  if (!(valid_[row] & kCommand)) {
+    command_[row] = strings_.Intern(LinuxParser::Command(pid_[row]));
+    valid_[row] |= kCommand;
+  }
+  return strings_.View(command_[row]);
+}
+
+// Names are interned per uid, so resolving a user is a map lookup after the
+// first process of that uid.
+string_view ProcessTable::User(Row row) {
+  if (!(valid_[row] & kUser)) {
+    if (!(valid_[row] & kUid) && !ReadUid(row)) {
+      return string_view();  // exited; retried while the row lives
+    }
+    auto it = user_names_.find(uid_[row]);
+    if (it == user_names_.end()) {
+      StringInterner::Handle name = strings_.Intern(
+          LinuxParser::UserName(std::to_string(uid_[row])));
+      it = user_names_.emplace(uid_[row], name).first;
+    }
+    user_[row] = it->second;
+    valid_[row] |= kUser;
+  }
+  return strings_.View(user_[row]);
+}
+
+// New rows are not read here; the scheduler plans them ahead of every
+// other tier except visible rows.
+void ProcessTable::AddRow(int pid) {
+  Row row = static_cast<Row>(pid_.size());
+  rows_[pid] = row;
+  pid_.push_back(pid);
+  cpu_ns_.push_back(0);
+  prev_cpu_ns_.push_back(0);
+  wait_ns_.push_back(0);
+  prev_wait_ns_.push_back(0);
+  slices_.push_back(0);
+  prev_slices_.push_back(0);
+  time_ns_.push_back(0);
+  prev_time_ns_.push_back(0);
+  vsize_.push_back(0);
+  rss_.push_back(0);
+  start_ticks_.push_back(0);
+  utilization_.push_back(0.0);
+  latency_ns_.push_back(0.0);
+  seen_.push_back(tick_);
+  sampled_.push_back(0);
+  valid_.push_back(0);
+  for (vector<int>& fds : fds_) {
+    fds.push_back(-1);
+  }
+  io_bytes_.push_back(0);
+  prev_io_bytes_.push_back(0);
+  io_rate_.push_back(0.0);
+  if (percentiles_) {
+    cpu_windows_.emplace_back();
+    rss_windows_.emplace_back();
+  }
+  uid_.push_back(0);
+  user_.push_back(StringInterner::kEmpty);
+  command_.push_back(StringInterner::kEmpty);
+}
+
+void ProcessTable::RemoveRow(Row row) {
+  CloseFds(row);
+  if (valid_[row] & kAccounted) {
+    AddUsage(row, -1);
+    Unaccount(row);
+  }
+  rows_.erase(pid_[row]);
+  if (row + 1 != pid_.size()) {
+    rows_[pid_.back()] = row;
+  }
+  SwapRemove(row, pid_, cpu_ns_, prev_cpu_ns_, wait_ns_, prev_wait_ns_,
+             slices_, prev_slices_, time_ns_, prev_time_ns_, vsize_, rss_,
+             start_ticks_, utilization_, latency_ns_, seen_, sampled_, valid_,
+             fds_[kStatFile], fds_[kSchedstatFile], fds_[kIoFile], io_bytes_,
+             prev_io_bytes_, io_rate_, uid_, user_, command_);
+  if (percentiles_) {
+    SwapRemove(row, cpu_windows_, rss_windows_);
+  }
+}
+
+void ProcessTable::CloseFds(Row row) {
+  for (vector<int>& fds : fds_) {
+    if (fds[row] >= 0) {
+      close(fds[row]);
+      fds[row] = -1;
+      open_fds_--;
+    }
+  }
+}
+
+// Adds (sign 1) or takes back (sign -1) the row's current values in its
+// user's totals.
+void ProcessTable::AddUsage(Row row, int sign) {
+  UserUsage& usage = users_[uid_[row]];
+  usage.cpu_ppm += sign * CpuPpm(utilization_[row]);
+  usage.rss += sign * rss_[row];
+  usage.io_rate += sign * std::llround(io_rate_[row]);
+}
+
+// Counts the row's process towards its user, once its uid is known.
+void ProcessTable::Account(Row row) {
+  UserUsage& usage = users_[uid_[row]];
+  if (usage.processes++ == 0) {
+    usage.uid = uid_[row];
+    usage.name = LinuxParser::UserName(std::to_string(uid_[row]));
+  }
+  valid_[row] |= kAccounted;
+}
+
+// Takes the row out of its user's process count; its values must already
+// have been subtracted with AddUsage().
+void ProcessTable::Unaccount(Row row) {
+  auto it = users_.find(uid_[row]);
+  if (--it->second.processes == 0) {
+    users_.erase(it);
+  }
+  valid_[row] &= ~kAccounted;
+}
+
+const vector<ProcessTable::UserUsage>& ProcessTable::Users() {
+  sorted_users_.clear();
+  for (const auto& entry : users_) {
+    sorted_users_.push_back(entry.second);
+  }
+  auto key = [this](const UserUsage& usage) -> int64_t {
+    switch (sort_key_) {
+      case SortKey::kMemory:
+        return -usage.rss;
+      case SortKey::kPid:
+        return usage.uid;
+      default:
+        return -usage.cpu_ppm;
+    }
+  };
+  std::sort(sorted_users_.begin(), sorted_users_.end(),
+            [&](const UserUsage& a, const UserUsage& b) {
+              int64_t left = key(a);
+              int64_t right = key(b);
+              if (left != right) {
+                return sort_reverse_ ? right < left : left < right;
+              }
+              return a.uid < b.uid;
+            });
+  return sorted_users_;
+}
+
+// Makes room for `needed` more descriptors by closing those of the rows read
+// least recently. Evicts down to 7/8 of the limit so this doesn't run again
+// on every tick once the cache is full.
+void ProcessTable::EvictFds(size_t needed) {
+  if (open_fds_ + needed <= fd_limit_ || open_fds_ == 0) {
+    return;
+  }
+  const size_t low_water = fd_limit_ - fd_limit_ / 8;
+  evict_keys_.clear();
+  for (Row row = 0; row < pid_.size(); row++) {
+    if (fds_[kStatFile][row] >= 0 || fds_[kSchedstatFile][row] >= 0 ||
+        fds_[kIoFile][row] >= 0) {
+      evict_keys_.push_back(static_cast<uint64_t>(sampled_[row]) << 32 | row);
+    }
+  }
+  // Every candidate holds at least one descriptor
+  size_t count = std::min(open_fds_ + needed - low_water, evict_keys_.size());
+  std::nth_element(evict_keys_.begin(), evict_keys_.begin() + count - 1,
+                   evict_keys_.end());
+  for (size_t i = 0; i < count; i++) {
+    CloseFds(static_cast<Row>(evict_keys_[i]));
+  }
+}
+
+// Reads this tick's counters for a batch of rows through the ProcReader and
+// timestamps them. A row's first read is its baseline: prev == current,
+// so its first utilization is 0 rather than its whole lifetime's CPU time.
+// Files are read through the row's cached descriptors, and newly opened
+// ones are kept while there is room under the limit. The rows' values are
+// taken out of their users' totals here and added back by Update() once
+// utilization is recomputed.
+void ProcessTable::ReadRows(const Row* rows, size_t count) {
+  if (count == 0) {
+    return;
+  }
+  const size_t per_row = files_.size();
+  const size_t total = count * per_row;
+  paths_.resize(total * kPathSize);
+  buffers_.resize(total * kBufferSize);
+  requests_.resize(total);
+  size_t opening = 0;
+  for (size_t i = 0; i < total; i++) {
+    Row row = rows[i / per_row];
+    File file = files_[i % per_row];
+    int fd = fds_[file][row];
+    char* path = &paths_[i * kPathSize];
+    if (fd < 0) {
+      std::snprintf(path, kPathSize, "/proc/%d/%s", pid_[row],
+                    kFileNames[file]);
+    }
+    bool keep = fd < 0 && open_fds_ + opening < fd_limit_;
+    opening += keep;
+    requests_[i] = {path, fd, keep, &buffers_[i * kBufferSize],
+                    static_cast<uint32_t>(kBufferSize), 0};
+  }
+  ReadRequests();
+
+  const int64_t now_ns = MonotonicNs();
+  for (size_t i = 0; i < total; i++) {
+    const ProcReader::Request& request = requests_[i];
+    Row row = rows[i / per_row];
+    int& fd = fds_[files_[i % per_row]][row];
+    if (fd < 0 && request.fd >= 0) {
+      fd = request.fd;
+      open_fds_++;
+    }
+  }
+  for (size_t i = 0; i < count; i++) {
+    Row row = rows[i];
+    if (valid_[row] & kAccounted) {
+      AddUsage(row, -1);
+    }
+    read_rows_.push_back(row);
+    // A held descriptor outlives its process; the pid may already name a
+    // new one, so drop the descriptors, the identity and the accounting
+    // (its usage was subtracted above) and take a fresh baseline
+    bool exited = false;
+    for (size_t j = i * per_row; j < (i + 1) * per_row; j++) {
+      exited |= requests_[j].result == -ESRCH;
+    }
+    if (exited) {
+      CloseFds(row);
+      if (valid_[row] & kAccounted) {
+        Unaccount(row);
+      }
+      valid_[row] = 0;
+      sampled_[row] = 0;
+      utilization_[row] = 0.0f;
+      if (percentiles_) {
+        cpu_windows_[row] = WindowedSketch();
+        rss_windows_[row] = WindowedSketch();
+      }
+      continue;
+    }
+    LinuxParser::ProcStat stat;
+    bool scheduled = false;  // schedstat read and parsed
+    for (size_t j = i * per_row; j < (i + 1) * per_row; j++) {
+      const ProcReader::Request& request = requests_[j];
+      if (request.result <= 0) {
+        continue;
+      }
+      string_view text(request.buffer, request.result);
+      switch (files_[j - i * per_row]) {
+        case kStatFile:
+          stat = LinuxParser::ParseStatLine(text);
+          if (!(valid_[row] & kUid)) {
+            ReadUid(row);
+          }
+          break;
+        case kSchedstatFile: {
+          LinuxParser::SchedStat sched = LinuxParser::ParseSchedstatLine(text);
+          if (sched.valid && !(valid_[row] & kStatCpu)) {
+            cpu_ns_[row] = sched.run_ns;
+            wait_ns_[row] = sched.wait_ns;
+            slices_[row] = sched.timeslices;
+          }
+          scheduled = sched.valid;
+          break;
+        }
+        case kIoFile: {
+          LinuxParser::IoStat io = LinuxParser::ParseIo(text);
+          if (io.valid) {
+            io_bytes_[row] = io.read_bytes + io.write_bytes;
+          }
+          break;
+        }
+        default:
+          break;
+      }
+    }
+    if (schedstat_ && !scheduled && stat.valid &&
+        !(valid_[row] & kStatCpu)) {
+      // No schedstats for this process (kernel without them, permissions,
+      // short read): count stat's ticks from now on, from a fresh baseline
+      valid_[row] |= kStatCpu;
+      sampled_[row] = 0;
+    }
+    Store(row, stat);
+    if ((valid_[row] & (kUid | kAccounted)) == kUid) {
+      Account(row);
+    }
+    time_ns_[row] = now_ns;
+    if (sampled_[row] != 0) {
+      sampled_rows_.push_back(row);
+      valid_[row] |= kMeasured;
+    } else {
+      prev_cpu_ns_[row] = cpu_ns_[row];
+      prev_wait_ns_[row] = wait_ns_[row];
+      prev_slices_[row] = slices_[row];
+      prev_io_bytes_[row] = io_bytes_[row];
+      prev_time_ns_[row] = time_ns_[row];
+    }
+    sampled_[row] = tick_;
+  }
+}
+
+// Once per process. Not the owner of /proc/<pid>: that is root for every
+// non-dumpable process, such as workers that called setuid() without exec.
+bool ProcessTable::ReadUid(Row row) {
+  string uid = LinuxParser::EffectiveUid(pid_[row]);
+  if (uid.empty()) {
+    return false;
+  }
+  uid_[row] = std::stoul(uid);
+  valid_[row] |= kUid;
+  return true;
+}
+
+// Splits the batch across read_threads_ when priming with the pread
+// backend; io_uring already overlaps the reads in the kernel.
+void ProcessTable::ReadRequests() {
+  const size_t total = requests_.size();
+  size_t threads =
+      std::min<size_t>(read_threads_, total / kMinRequestsPerThread);
+  if (threads <= 1 || reader_->Kind() != ProcReader::Backend::kPread) {
+    reader_->Read(requests_.data(), total);
+    if (reader_->Failed()) {
+      reader_ = ProcReader::Create(ProcReader::Backend::kPread);
+    }
+    return;
+  }
+  const size_t per_thread = (total + threads - 1) / threads;
+  vector<std::thread> workers;
+  for (size_t first = per_thread; first < total; first += per_thread) {
+    size_t count = std::min(per_thread, total - first);
+    workers.emplace_back(
+        [this, first, count] { reader_->Read(&requests_[first], count); });
+  }
+  reader_->Read(requests_.data(), per_thread);
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+}
+
+// A failed read means the process exited after enumeration; its row keeps
+// the last sample until the next tick drops it.
+void ProcessTable::Store(Row row, const LinuxParser::ProcStat& stat) {
+  if (!stat.valid) {
+    return;
+  }
+  if (!schedstat_ || (valid_[row] & kStatCpu)) {
+    // cutime/cstime are reaped children's time and don't belong to the row
+    static const int64_t ns_per_tick = 1000000000LL / LinuxParser::ClockTicks();
+    cpu_ns_[row] = (stat.utime + stat.stime) * ns_per_tick;
+  }
+  vsize_[row] = stat.vsize;
+  rss_[row] = stat.rss;
+  start_ticks_[row] = stat.starttime;
+}
+
+// Straight-line loops over the hot columns with no calls or data-dependent
+// branches, so the compiler can vectorize them.
+void ProcessTable::ComputeUtilization() {
+  const size_t size = pid_.size();
+  const int64_t* cpu_ns = cpu_ns_.data();
+  const int64_t* prev_cpu_ns = prev_cpu_ns_.data();
+  const int64_t* time_ns = time_ns_.data();
+  const int64_t* prev_time_ns = prev_time_ns_.data();
+  float* utilization = utilization_.data();
+
+  for (size_t i = 0; i < size; i++) {
+    float elapsed = static_cast<float>(time_ns[i] - prev_time_ns[i]);
+    float busy = static_cast<float>(cpu_ns[i] - prev_cpu_ns[i]);
+    float value = elapsed > 0.0f ? busy / elapsed : utilization[i];
+    utilization[i] = value > 0.0f ? value : 0.0f;
+  }
+
+  if (schedstat_) {
+    const int64_t* wait_ns = wait_ns_.data();
+    const int64_t* prev_wait_ns = prev_wait_ns_.data();
+    const int64_t* slices = slices_.data();
+    const int64_t* prev_slices = prev_slices_.data();
+    float* latency_ns = latency_ns_.data();
+    for (size_t i = 0; i < size; i++) {
+      float waited = static_cast<float>(wait_ns[i] - prev_wait_ns[i]);
+      float ran = static_cast<float>(slices[i] - prev_slices[i]);
+      latency_ns[i] = ran > 0.0f ? waited / ran : 0.0f;
+    }
+  }
+
+  if (io_) {
+    const int64_t* io_bytes = io_bytes_.data();
+    const int64_t* prev_io_bytes = prev_io_bytes_.data();
+    float* io_rate = io_rate_.data();
+    for (size_t i = 0; i < size; i++) {
+      float elapsed = static_cast<float>(time_ns[i] - prev_time_ns[i]);
+      float bytes = static_cast<float>(io_bytes[i] - prev_io_bytes[i]);
+      io_rate[i] = elapsed > 0.0f ? bytes * 1e9f / elapsed : io_rate[i];
+    }
+  }
+
+  prev_cpu_ns_ = cpu_ns_;
+  prev_wait_ns_ = wait_ns_;
+  prev_slices_ = slices_;
+  prev_io_bytes_ = io_bytes_;
+  prev_time_ns_ = time_ns_;
+}
+
+// Sorts rows by the current sort key. Each key packs a 32-bit value that
+// orders like an unsigned int above the row index, and an LSD radix sort
+// over the upper 32 bits permutes them. Utilization and latency are
+// non-negative, so their IEEE bits already order that way. Rows with
+// equal values keep their row order.
+void ProcessTable::Rank() {
+  const size_t size = pid_.size();
+  sort_keys_.resize(size);
+  sort_scratch_.resize(size);
+  const uint32_t flip = sort_reverse_ ? ~0u : 0u;
+  auto fill = [&](auto value) {
+    for (size_t row = 0; row < size; row++) {
+      sort_keys_[row] =
+          (static_cast<uint64_t>(value(row) ^ flip) << 32) | row;
+    }
+  };
+  auto float_bits = [](float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  };
+  auto clamp = [](uint64_t value) {
+    return static_cast<uint32_t>(std::min<uint64_t>(value, UINT32_MAX));
+  };
+  switch (sort_key_) {
+    case SortKey::kCpu:
+      fill([&](size_t row) { return ~float_bits(utilization_[row]); });
+      break;
+    case SortKey::kMemory:
+      fill([&](size_t row) { return ~clamp(vsize_[row] >> 12); });
+      break;
+    case SortKey::kPid:
+      fill([&](size_t row) { return static_cast<uint32_t>(pid_[row]); });
+      break;
+    case SortKey::kTime:
+      fill([&](size_t row) { return clamp(start_ticks_[row]); });
+      break;
+    case SortKey::kLatency:
+      fill([&](size_t row) { return ~float_bits(latency_ns_[row]); });
+      break;
+    case SortKey::kCpuP99:
+      // Merges six slices per row, so it only runs under this sort
+      sort_values_.assign(size, 0.0f);
+      if (percentiles_) {
+        for (size_t row = 0; row < size; row++) {
+          sort_values_[row] = CpuWindow(row, Window::k5m).Quantile(0.99f);
+        }
+      }
+      fill([&](size_t row) { return ~float_bits(sort_values_[row]); });
+      break;
+  }
+
+  for (int shift = 32; shift < 64; shift += 8) {
+    size_t counts[257] = {};
+    for (uint64_t key : sort_keys_) {
+      counts[((key >> shift) & 0xff) + 1]++;
+    }
+    for (int i = 0; i < 256; i++) {
+      counts[i + 1] += counts[i];
+    }
+    for (uint64_t key : sort_keys_) {
+      sort_scratch_[counts[(key >> shift) & 0xff]++] = key;
+    }
+    sort_keys_.swap(sort_scratch_);
+  }
+
+  order_.resize(size);
+  for (size_t i = 0; i < size; i++) {
+    order_[i] = static_cast<Row>(sort_keys_[i]);
+  }
+}
@@ -1,7 +1,13 @@
 #include "processor.h"
 #include "linux_parser.h"
 
+// LinuxParser::CpuUtilization is a delta against its previous call, so it
+// must only run once per tick.
+void Processor::Update() {
+    utilization_ = LinuxParser::CpuUtilization();
+}
+
 // TODO: Return the aggregate CPU utilization
 float Processor::Utilization() { 
-    return LinuxParser::CpuUtilization();
-}
\ No newline at end of file
+    return utilization_;
+}
@@ -0,0 +1,75 @@
+#include "refresh_scheduler.h"
+
+#include <time.h>
+
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+namespace {
+int64_t MonotonicNs() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+}
+}  // namespace
+
+const vector<RefreshScheduler::Row>& RefreshScheduler::Plan(
+    uint32_t tick, const vector<int>& pids, const vector<float>& utilization,
+    const vector<uint32_t>& sampled, const vector<uint8_t>& visible,
+    const vector<uint8_t>& measured) {
+  enum Tier { kVisible, kNew, kHot, kOverdue, kDue };
+  for (vector<Row>& tier : tiers_) {
+    tier.clear();
+  }
+  const uint32_t interval = policy_.idle_interval > 1 ? policy_.idle_interval : 1;
+  const size_t size = pids.size();
+  for (Row row = 0; row < size; row++) {
+    if (visible[row]) {
+      tiers_[kVisible].push_back(row);
+    } else if (sampled[row] == 0 || !measured[row]) {
+      tiers_[kNew].push_back(row);
+    } else if (utilization[row] >= policy_.hot_threshold) {
+      tiers_[kHot].push_back(row);
+    } else if (tick - sampled[row] > interval) {
+      tiers_[kOverdue].push_back(row);
+    } else if (static_cast<uint32_t>(pids[row]) % interval ==
+               tick % interval) {
+      tiers_[kDue].push_back(row);
+    }
+  }
+
+  plan_.clear();
+  for (const vector<Row>& tier : tiers_) {
+    plan_.insert(plan_.end(), tier.begin(), tier.end());
+  }
+  return plan_;
+}
+
+void RefreshScheduler::StartTick() {
+  reads_ = 0;
+  exhausted_ = false;
+  deadline_ns_ = policy_.budget_ms > 0
+                     ? MonotonicNs() + policy_.budget_ms * 1000000LL
+                     : 0;
+}
+
+bool RefreshScheduler::Spend(int reads) {
+  if (exhausted_) {
+    return false;
+  }
+  if (policy_.budget_reads > 0 && reads_ + reads > policy_.budget_reads) {
+    exhausted_ = true;
+  } else {
+    reads_ += reads;
+  }
+  return !exhausted_;
+}
+
+bool RefreshScheduler::WithinDeadline() {
+  if (deadline_ns_ != 0 && MonotonicNs() >= deadline_ns_) {
+    exhausted_ = true;
+  }
+  return !exhausted_;
+}
@@ -0,0 +1,184 @@
+#include "sketch.h"
+
+#include <time.h>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+
+namespace {
+constexpr int16_t kNoBuckets = INT16_MIN;
+const float kGamma =
+    (1 + Sketch::kRelativeAccuracy) / (1 - Sketch::kRelativeAccuracy);
+const float kLogGamma = std::log(kGamma);
+
+int Key(float value) {
+  return static_cast<int>(std::ceil(std::log(value) / kLogGamma));
+}
+
+// Midpoint of the bucket in relative terms, so the error is the same
+// either way
+float Value(int key) { return 2 * std::pow(kGamma, key) / (kGamma + 1); }
+}  // namespace
+
+void Sketch::Add(float value) {
+  max_ = std::max(max_, value);
+  if (value <= kMinValue) {
+    if (zeros_ == UINT16_MAX) Halve();
+    zeros_++;
+    return;
+  }
+  int key = Key(value);
+  if (offset_ == kNoBuckets) {
+    offset_ = key - kBuckets + 1;
+  } else if (key >= offset_ + kBuckets) {
+    Raise(key);
+  }
+  int index = std::max(key - offset_, 0);
+  if (counts_[index] == UINT16_MAX) Halve();
+  counts_[index]++;
+}
+
+void Sketch::Raise(int key) {
+  int shift = key - kBuckets + 1 - offset_;
+  uint32_t collapsed = 0;
+  for (int i = 0; i < kBuckets; i++) {
+    if (i <= shift) {
+      collapsed += counts_[i];
+    }
+  }
+  for (int i = 1; i < kBuckets; i++) {
+    counts_[i] = i + shift < kBuckets ? counts_[i + shift] : 0;
+  }
+  while (collapsed > UINT16_MAX) {
+    Halve();
+    collapsed = (collapsed + 1) / 2;
+  }
+  counts_[0] = collapsed;
+  offset_ += shift;
+}
+
+// Keeps the proportions when a count would overflow; quantiles barely move.
+void Sketch::Halve() {
+  for (uint16_t& count : counts_) {
+    count = (count + 1) / 2;
+  }
+  zeros_ = (zeros_ + 1) / 2;
+}
+
+void Sketch::Merge(const Sketch& other) {
+  if (other.Empty()) {
+    return;
+  }
+  max_ = std::max(max_, other.max_);
+  uint32_t zeros = zeros_ + other.zeros_;
+  uint32_t counts[kBuckets] = {};
+  int offset = std::max(offset_, other.offset_);
+  const Sketch* self = this;
+  for (const Sketch* sketch : {self, &other}) {
+    if (sketch->offset_ == kNoBuckets) continue;
+    for (int i = 0; i < kBuckets; i++) {
+      counts[std::max(sketch->offset_ + i - offset, 0)] += sketch->counts_[i];
+    }
+  }
+  uint32_t largest = *std::max_element(counts, counts + kBuckets);
+  int halvings = 0;
+  for (uint32_t top = std::max(largest, zeros); top > UINT16_MAX;
+       top = (top + 1) / 2) {
+    halvings++;
+  }
+  for (int i = 0; i < kBuckets; i++) {
+    uint32_t count = counts[i];
+    for (int h = 0; h < halvings; h++) count = (count + 1) / 2;
+    counts_[i] = count;
+  }
+  for (int h = 0; h < halvings; h++) zeros = (zeros + 1) / 2;
+  zeros_ = zeros;
+  offset_ = offset;
+}
+
+float Sketch::Quantile(float q) const {
+  if (Empty()) {
+    return 0.0f;
+  }
+  if (q >= 1.0f) {
+    return max_;
+  }
+  uint32_t total = zeros_;
+  for (uint16_t count : counts_) {
+    total += count;
+  }
+  float rank = std::clamp(q, 0.0f, 1.0f) * (total - 1);
+  uint32_t seen = zeros_;
+  if (rank < seen) {
+    return 0.0f;
+  }
+  for (int i = 0; i < kBuckets; i++) {
+    seen += counts_[i];
+    if (rank < seen) {
+      return std::min(Value(offset_ + i), max_);
+    }
+  }
+  return max_;
+}
+
+uint32_t WindowedSketch::MinuteNow() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<uint32_t>(now.tv_sec / 60);
+}
+
+void WindowedSketch::Add(float value, uint32_t minute) {
+  Rotate(minute);
+  minutes_[minute_ % kMinutes].Add(value);
+}
+
+// Folds the five-minute period that just ended into its slice before the
+// minute slices it came from are reused, and empties every slice skipped.
+void WindowedSketch::Rotate(uint32_t minute) {
+  if (minute <= minute_) {
+    return;
+  }
+  uint32_t period = minute_ / 5;
+  uint32_t next = minute / 5;
+  if (next > period) {
+    Sketch& folded = periods_[period % kPeriods];
+    folded.Clear();
+    for (uint32_t m = period * 5; m <= minute_; m++) {
+      folded.Merge(minutes_[m % kMinutes]);
+    }
+    for (uint32_t p = period + 1; p < next && p <= period + kPeriods; p++) {
+      periods_[p % kPeriods].Clear();
+    }
+  }
+  for (uint32_t m = minute_ + 1; m <= minute && m <= minute_ + kMinutes; m++) {
+    minutes_[m % kMinutes].Clear();
+  }
+  minute_ = minute;
+}
+
+Sketch WindowedSketch::Query(Window window, uint32_t minute) {
+  Rotate(minute);
+  Sketch result;
+  switch (window) {
+    case Window::k1m:
+      result.Merge(minutes_[minute_ % kMinutes]);
+      result.Merge(minutes_[(minute_ + kMinutes - 1) % kMinutes]);
+      break;
+    case Window::k5m:
+      for (const Sketch& slice : minutes_) {
+        result.Merge(slice);
+      }
+      break;
+    case Window::k15m:
+      for (uint32_t m = minute_ / 5 * 5; m <= minute_; m++) {
+        result.Merge(minutes_[m % kMinutes]);
+      }
+      for (const Sketch& slice : periods_) {
+        result.Merge(slice);
+      }
+      break;
+  }
+  return result;
+}
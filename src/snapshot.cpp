@@ -0,0 +1,206 @@
+#include "snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "process_table.h"
+#include "system.h"
+
+using std::string;
+using std::string_view;
+using Snapshot::Header;
+using Snapshot::ProcessRecord;
+using Snapshot::Slot;
+
+namespace {
+constexpr int kReadAttempts = 16;
+
+[[noreturn]] void Fail(const string& what) {
+  throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+size_t SlotSize(uint32_t max_processes) {
+  size_t size = sizeof(Slot) + max_processes * sizeof(ProcessRecord);
+  return (size + alignof(Slot) - 1) / alignof(Slot) * alignof(Slot);
+}
+
+size_t FirstSlotOffset() {
+  return (sizeof(Header) + alignof(Slot) - 1) / alignof(Slot) * alignof(Slot);
+}
+
+template <typename Segment>
+auto SlotAt(Segment* segment, const Header& header, uint64_t generation) {
+  using Byte = std::conditional_t<std::is_const_v<Segment>, const char, char>;
+  using SlotType = std::conditional_t<std::is_const_v<Segment>, const Slot, Slot>;
+  Byte* base = static_cast<Byte*>(segment) + FirstSlotOffset();
+  return reinterpret_cast<SlotType*>(
+      base + (generation % header.slot_count) * header.slot_size);
+}
+
+template <typename SlotType>
+auto RecordsOf(SlotType* slot) {
+  using Record = std::conditional_t<std::is_const_v<SlotType>,
+                                    const ProcessRecord, ProcessRecord>;
+  return reinterpret_cast<Record*>(slot + 1);
+}
+
+template <size_t N>
+uint16_t CopyString(char (&dest)[N], string_view value) {
+  size_t length = std::min(N, value.size());
+  std::memcpy(dest, value.data(), length);
+  if (length < N) dest[length] = '\0';
+  return static_cast<uint16_t>(length);
+}
+}  // namespace
+
+SnapshotPublisher::SnapshotPublisher(const string& name,
+                                     uint32_t max_processes)
+    : name_(name) {
+  // Start from a fresh segment so its geometry always matches ours
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+  if (fd < 0) Fail("shm_open " + name);
+  size_t slot_size = SlotSize(max_processes);
+  size_ = FirstSlotOffset() + Snapshot::kSlots * slot_size;
+  if (ftruncate(fd, size_) < 0) {
+    int error = errno;
+    close(fd);
+    shm_unlink(name.c_str());
+    errno = error;
+    Fail("ftruncate " + name);
+  }
+  mapping_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping_ == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    Fail("mmap " + name);
+  }
+
+  // The segment is zero-filled, so every slot starts at sequence 0 and
+  // readers see nothing until `magic` and the first slot are written.
+  Header* header = new (mapping_) Header{};
+  header->version = Snapshot::kVersion;
+  header->slot_count = Snapshot::kSlots;
+  header->max_processes = max_processes;
+  header->slot_size = slot_size;
+  header->magic.store(Snapshot::kMagic, std::memory_order_release);
+}
+
+SnapshotPublisher::~SnapshotPublisher() {
+  munmap(mapping_, size_);
+  shm_unlink(name_.c_str());
+}
+
+void SnapshotPublisher::Publish(System& system) {
+  Header* header = static_cast<Header*>(mapping_);
+  uint64_t generation = ++generation_;
+  Slot* slot = SlotAt(mapping_, *header, generation);
+
+  slot->sequence.store(2 * generation + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  Snapshot::SystemRecord& record = slot->system;
+  record.cpu_utilization = system.Cpu().Utilization();
+  record.memory_utilization = system.MemoryUtilization();
+  record.uptime = system.UpTime();
+  record.total_processes = system.TotalProcesses();
+  record.running_processes = system.RunningProcesses();
+  CopyString(record.kernel, system.Kernel());
+  CopyString(record.operating_system, system.OperatingSystem());
+
+  ProcessTable& processes = system.Processes();
+  uint32_t count = std::min<size_t>(processes.Size(), header->max_processes);
+  ProcessRecord* records = RecordsOf(slot);
+  for (uint32_t rank = 0; rank < count; rank++) {
+    ProcessTable::Row row = processes.Ranked(rank);
+    ProcessRecord& process = records[rank];
+    process.pid = processes.Pid(row);
+    process.cpu_utilization = processes.CpuUtilization(row);
+    process.uid = processes.Uid(row);
+    process.io_rate = processes.IoRate(row);
+    process.vsize = processes.Vsize(row);
+    process.rss = processes.Rss(row);
+    process.start_ticks = processes.StartTicks(row);
+    // Loaded once per process and cached with the row
+    process.user_length = CopyString(process.user, processes.User(row));
+    process.command_length =
+        CopyString(process.command, processes.Command(row));
+  }
+  slot->process_count = count;
+
+  slot->sequence.store(2 * generation + 2, std::memory_order_release);
+  header->latest.store(generation, std::memory_order_release);
+}
+
+SnapshotReader::SnapshotReader(const string& name) {
+  int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+  if (fd < 0) Fail("shm_open " + name);
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    int error = errno;
+    close(fd);
+    errno = error;
+    Fail("fstat " + name);
+  }
+  size_ = st.st_size;
+  void* mapping = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) Fail("mmap " + name);
+  mapping_ = mapping;
+
+  const Header* header = static_cast<const Header*>(mapping_);
+  bool valid =
+      size_ >= FirstSlotOffset() &&
+      header->magic.load(std::memory_order_acquire) == Snapshot::kMagic &&
+      header->version == Snapshot::kVersion && header->slot_count > 0 &&
+      header->slot_size >= SlotSize(header->max_processes) &&
+      size_ >= FirstSlotOffset() + header->slot_count * header->slot_size;
+  if (!valid) {
+    munmap(const_cast<void*>(mapping_), size_);
+    errno = EPROTO;
+    Fail("incompatible snapshot segment " + name);
+  }
+}
+
+SnapshotReader::~SnapshotReader() {
+  munmap(const_cast<void*>(mapping_), size_);
+}
+
+// Retries when the writer lapped the ring while we were copying; with
+// several slots that only happens to readers stalled for a whole ring.
+bool SnapshotReader::Read(Snapshot::Data& data) {
+  const Header* header = static_cast<const Header*>(mapping_);
+  for (int attempt = 0; attempt < kReadAttempts; attempt++) {
+    uint64_t generation = header->latest.load(std::memory_order_acquire);
+    if (generation == 0) {
+      return false;
+    }
+    const Slot* slot = SlotAt(mapping_, *header, generation);
+    uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+    if (sequence != 2 * generation + 2) {
+      continue;
+    }
+    data.system = slot->system;
+    uint32_t count = std::min(slot->process_count, header->max_processes);
+    data.processes.resize(count);
+    std::memcpy(data.processes.data(), RecordsOf(slot),
+                count * sizeof(ProcessRecord));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot->sequence.load(std::memory_order_relaxed) == sequence) {
+      return true;
+    }
+  }
+  return false;
+}
@@ -1,12 +1,16 @@
 #include <unistd.h>
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
 #include <set>
+#include <cstring>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
-#include <map>
-#include <algorithm>
 
 #include "process.h"
+#include "process_table.h"
 #include "processor.h"
 #include "system.h"
 #include "linux_parser.h"
@@ -14,31 +18,103 @@
 using std::set;
 using std::size_t;
 using std::string;
+using std::string_view;
 using std::vector;
-using std::map;
 
-// TODO: Return the system's CPU
-Processor& System::Cpu() { return cpu_; }
+void System::Refresh() {
+    if (source_) {
+        Load();
+        return;
+    }
+    cpu_.Update();
+    memory_utilization_ = LinuxParser::MemoryUtilization();
+    uptime_ = LinuxParser::UpTime();
+    total_processes_ = LinuxParser::TotalProcesses();
+    processes_.Update(Pids());
+    AddWindowSamples();
+}
+
+void System::Prime(int prime_ms) {
+    if (source_) {
+        return;
+    }
+    cpu_.Update();
+    int threads = std::clamp<int>(std::thread::hardware_concurrency(), 1, 8);
+    processes_.Prime(Pids(), threads);
+    std::this_thread::sleep_for(std::chrono::milliseconds(prime_ms));
+}
+
+void System::MarkFirstFrame() {
+    if (first_frame_seconds_ >= 0) {
+        return;
+    }
+    std::chrono::duration<float> elapsed =
+        std::chrono::steady_clock::now() - started_;
+    first_frame_seconds_ = elapsed.count();
+}
+
+// Running pids, narrowed to the filter; also counts the running processes
+vector<int> System::Pids() {
+    vector<int> pids = LinuxParser::Pids();
+    running_processes_ = pids.size();
+    if (!pid_filter_.empty()) {
+        // Selected processes only; skips the per-pid reads of the rest
+        pids.erase(std::remove_if(pids.begin(), pids.end(), [this](int pid) {
+                       return std::find(pid_filter_.begin(), pid_filter_.end(),
+                                        pid) == pid_filter_.end();
+                   }),
+                   pids.end());
+    }
+    return pids;
+}
 
-vector<Process>& System::Processes() { 
-    vector<int> current_pids = LinuxParser::Pids();
-    vector<Process> new_processes;
-    map<int, Process> existing_processes;
-    for (auto& process : processes_) {
-        existing_processes[process.Pid()] = process;
+// Keeps the previous values if no snapshot could be read this tick
+void System::Load() {
+    if (!source_->Read(snapshot_)) {
+        return;
     }
+    const Snapshot::SystemRecord& record = snapshot_.system;
+    cpu_.Load(record.cpu_utilization);
+    memory_utilization_ = record.memory_utilization;
+    uptime_ = record.uptime;
+    total_processes_ = record.total_processes;
+    running_processes_ = record.running_processes;
+    kernel_.assign(record.kernel, strnlen(record.kernel, sizeof(record.kernel)));
+    operating_system_.assign(
+        record.operating_system,
+        strnlen(record.operating_system, sizeof(record.operating_system)));
 
-    for (int pid : current_pids) {
-        auto it = existing_processes.find(pid);
-        if (it != existing_processes.end()) {
-            // TODO(mau): Process exists, check if it's one we've seen before
-            new_processes.push_back(std::move(existing_processes[pid]));
-        } else {
-            new_processes.push_back(std::move(Process(pid)));
-        }
+    samples_.clear();
+    for (const Snapshot::ProcessRecord& process : snapshot_.processes) {
+        samples_.push_back({process.pid, process.cpu_utilization,
+                            process.vsize, process.rss, process.start_ticks,
+                            process.io_rate, process.uid,
+                            string_view(process.user, process.user_length),
+                            string_view(process.command,
+                                        process.command_length)});
     }
-    processes_ = new_processes;
-    std::sort(processes_.begin(), processes_.end());
+    processes_.Load(samples_);
+    AddWindowSamples();
+}
+
+void System::AddWindowSamples() {
+    uint32_t minute = WindowedSketch::MinuteNow();
+    cpu_window_.Add(cpu_.Utilization(), minute);
+    memory_window_.Add(memory_utilization_, minute);
+}
+
+Sketch System::CpuWindow(Window window) {
+    return cpu_window_.Query(window, WindowedSketch::MinuteNow());
+}
+
+Sketch System::MemoryWindow(Window window) {
+    return memory_window_.Query(window, WindowedSketch::MinuteNow());
+}
+
+// TODO: Return the system's CPU
+Processor& System::Cpu() { return cpu_; }
+
+ProcessTable& System::Processes() { 
     return processes_;
 }
 
@@ -49,7 +125,7 @@ std::string System::Kernel() {
 
 // TODO: Return the system's memory utilization
 float System::MemoryUtilization() { 
-    return LinuxParser::MemoryUtilization();
+    return memory_utilization_;
  }
 
 // TODO: Return the operating system name
@@ -59,15 +135,15 @@ std::string System::OperatingSystem() {
 
 // TODO: Return the number of processes actively running on the system
 int System::RunningProcesses() { 
-    return LinuxParser::RunningProcesses();
+    return running_processes_;
  }
 
 // TODO: Return the total number of processes on the system
 int System::TotalProcesses() { 
-    return LinuxParser::TotalProcesses();
+    return total_processes_;
  }
 
 // TODO: Return the number of seconds since the system started running
 long int System::UpTime() { 
-    return LinuxParser::UpTime();
+    return uptime_;
 }